@@ -22,14 +22,148 @@
 #include <iostream>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fcntl.h>
+#include <cerrno>
+#include <climits>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+
+extern char ** environ;
 
 using namespace arg;
 using namespace std;
 
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	// time of its scope added to `* ns`, if `ns` is given
+	class Timer
+	{
+		double * ns;
+		Clock::time_point t0;
+	public:
+		Timer(double * ns) :
+			ns(ns)
+		{
+			if (ns) t0 = Clock::now();
+		}
+
+		~Timer()
+		{
+			if (ns) * ns += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+		}
+	};
+}
+
+void * Arena::Counter::do_allocate(size_t n, size_t align)
+{
+	bytes += n;
+	return std::pmr::new_delete_resource()->allocate(n, align);
+}
+
+void Arena::Counter::do_deallocate(void * p, size_t n, size_t align)
+{
+	std::pmr::new_delete_resource()->deallocate(p, n, align);
+}
+
+bool Arena::Counter::do_is_equal(std::pmr::memory_resource const & r) const noexcept
+{
+	return this == & r;
+}
+
+Arena::Arena(size_t initial) :
+	pool(initial, & counter)
+{}
+
+size_t Arena::get_bytes() const
+{
+	return counter.bytes;
+}
+
+void * Arena::do_allocate(size_t n, size_t align)
+{
+	return pool.allocate(n, align);
+}
+
+void Arena::do_deallocate(void * p, size_t n, size_t align)
+{
+	pool.deallocate(p, n, align);
+}
+
+bool Arena::do_is_equal(std::pmr::memory_resource const & r) const noexcept
+{
+	return this == & r;
+}
+
+OptionStats const * Stats::find(string const & name) const
+{
+	for (auto & o: options) if (o.name == name) return & o;
+	return nullptr;
+}
+
+OptionStats const * Stats::find(int key) const
+{
+	for (auto & o: options) if (o.key == key) return & o;
+	return nullptr;
+}
+
+namespace {
+	// `s` as a JSON string
+	string json_str(string const & s)
+	{
+		string j = "\"";
+		for (unsigned char c: s) {
+			if (c == '"' || c == '\\') j += '\\';
+			if (c < 0x20) {
+				char u[8];
+				snprintf(u, sizeof(u), "\\u%04x", c);
+				j += u;
+			}
+			else j += c;
+		}
+		return j + '"';
+	}
+}
+
+string Stats::to_json() const
+{
+	ostringstream os;
+	os << "{\"parses\": " << parses << ", \"tokens\": " << tokens << ", \"parse_ns\": " << parse_ns
+		<< ", \"helps\": " << helps << ", \"help_ns\": " << help_ns << ", \"arena_bytes\": " << arena_bytes
+		<< ", \"options\": [";
+	for (size_t i = 0; i < options.size(); i ++) {
+		auto & o = options[i];
+		os << (i ? ", " : "") << "{\"key\": " << o.key << ", \"name\": " << json_str(o.name) << ", \"hits\": " << o.hits
+			<< ", \"sets\": " << o.sets << ", \"set_ns\": " << o.set_ns
+			<< ", \"calls\": " << o.calls << ", \"call_ns\": " << o.call_ns << "}";
+	}
+	os << "]}";
+	return os.str();
+}
+
 Value::~Value() {}
 
 void Value::set(std::string const &) {}
 
+bool Value::try_set(std::string_view str, exception_ptr * fault)
+{
+	try {
+		set(string(str));
+		return true;
+	}
+	catch (Error &) {
+		if (fault) * fault = current_exception();
+		return false;
+	}
+}
+
 string Value::to_str() const
 {
 	return string();
@@ -40,31 +174,49 @@ string Value::get_type() const
 	return "unknown";
 }
 
-Option::Option(int key, string const & name) :
+void Value::complete(string_view, vector<string> &) const {}
+
+ConvError Value::conv_error(string_view str) const
+{
+	return ConvError(string(str), get_type());
+}
+
+Option::Option(int key, string const & name, std::shared_ptr<std::pmr::memory_resource> arena) :
 	key(key),
-	name(name),
+	given(0),
 	store_optional(false),
-	set_bool(nullptr),
 	bool_value(false),
-	set_var(nullptr),
 	set_once(false),
+	set_bool(nullptr),
+	set_var(nullptr),
 	call_func(nullptr),
-	help_default(false)
-{}
+	stats(nullptr),
+	deferred(false),
+	init_taken(false),
+	pending_index(0),
+	name(name),
+	cold(make_in<Cold>(arena))
+{
+	cold->arena = arena;
+}
 
 Option::~Option() {}
 
 Option & Option::store(std::shared_ptr<Value> ptr)
 {
-	if (!ptr) ptr = std::make_shared<Value>(); // null storage
+	static auto const null_value = std::make_shared<Value>();
+	if (!ptr) ptr = null_value; // null storage
 	store_ptr = ptr;
+	init_taken = false; // taken when needed, to_str() can be costly
+	cold->rev ++;
 	return * this;
 }
 
 Option & Option::optional(string const & str)
 {
 	store_optional = true;
-	store_str = str;
+	cold->store_str = str;
+	cold->rev ++;
 	return * this;
 }
 
@@ -72,6 +224,8 @@ Option & Option::set(bool & var, bool value)
 {
 	set_bool = & var;
 	bool_value = value;
+	cold->bool_init = var;
+	cold->rev ++;
 	return * this;
 }
 
@@ -79,6 +233,8 @@ Option & Option::set(int * var, int value)
 {
 	set_var = var;
 	set_value = value;
+	if (var) cold->var_init = * var;
+	cold->rev ++;
 	return * this;
 }
 
@@ -86,6 +242,7 @@ Option & Option::once(int init)
 {
 	set_once = true;
 	set_init = init;
+	cold->rev ++;
 	return * this;
 }
 
@@ -93,265 +250,1785 @@ Option & Option::call(CallBack * func, void * data)
 {
 	call_func = func;
 	call_data = data;
+	cold->rev ++;
+	return * this;
+}
+
+Option & Option::help(string const & text, string const & var)
+{
+	cold->help_text = text;
+	if (var.size()) cold->help_var = var;
+	cold->rev ++;
+	return * this;
+}
+
+Option & Option::help_word(string const & var)
+{
+	cold->help_var = var;
+	cold->rev ++;
+	return * this;
+}
+
+Option & Option::env(string const & var)
+{
+	if (var.empty() && name.empty()) throw Error("no variable name for option -" + (isprint(key) ? string(1, char(key)) : to_string(key)));
+	cold->env_bound = true;
+	cold->env_var = var;
+	return * this;
+}
+
+Option & Option::show_default(bool do_show)
+{
+	cold->help_default = do_show;
+	cold->rev ++;
+	return * this;
+}
+
+bool Option::take_value() const
+{
+	return bool(store_ptr);
+}
+
+bool Option::need_value() const
+{
+	return store_ptr && ! store_optional;
+}
+
+int Option::get_key() const
+{
+	return key;
+}
+
+string const & Option::get_name() const
+{
+	return name;
+}
+
+string Option::get_help(HelpFormat format)
+{
+	string h = get_help_head(format);
+	if (h.size() < 26) h.resize(26, ' ');
+	h += "   ";
+	h += get_help_body();
+	return h;
+}
+
+string Option::get_help_head(HelpFormat format)
+{
+	string h;
+	bool s = isprint(key) && ! isspace(key);
+	bool v = store_ptr || (call_func && cold->help_var.size()); // a callback taking the value shows it if named
+
+	switch (format) {
+	case HF_REGULAR:
+		h = s ? (string("  -") + char(key)) : "    ";
+		if (name != "") h += (s ? ", --" : "  --") + name;
+		if (v) {
+			if (store_optional) h += "[=" + cold->help_var + "]";
+			else h += (name == "" ? " " : "=") + cold->help_var;
+		}
+		break;
+	case HF_NODASH:
+		h = "    ";
+		if (s) h += char(key);
+		if (name != "") h += (s ? ", " : "") + name;
+		if (v) {
+			if (name == "") {
+				if (store_optional) h += " [" + cold->help_var + "]";
+				else h += " " + cold->help_var;
+			}
+			else {
+				if (store_optional) h += "[=" + cold->help_var + "]";
+				else h += "=" + cold->help_var;
+			}
+		}
+		break;
+	}
+	return h;
+}
+
+string Option::get_help_body()
+{
+	string h = cold->help_text;
+	if (cold->help_default && store_ptr) { // append " (default: ...)" to help
+		h += " (default: ";
+		h += store_ptr->to_str();
+		h += ")";
+	}
+	return h;
+}
+
+void Option::process()
+{
+	exception_ptr fault;
+	ParseCode c = try_process(& fault);
+	if (c != ParseCode::ok) fail(c, cold->store_str, fault);
+}
+
+void Option::process(string const & str)
+{
+	exception_ptr fault;
+	ParseCode c = try_process(str, & fault);
+	if (c != ParseCode::ok) fail(c, str, fault);
+}
+
+ParseCode Option::try_process(exception_ptr * fault)
+{
+	if (stats) stats->hits ++;
+	deferred = false; // replacing the value left by a lazy parse
+	if (store_ptr) {
+		if (!store_optional) return ParseCode::missing_value;
+		if (stats) stats->sets ++;
+		Timer t(stats ? & stats->set_ns : nullptr);
+		if (! init_taken) take_init();
+		if (! store_ptr->try_set(cold->store_str, fault)) return ParseCode::bad_value; // use default value
+	}
+	ParseCode c = try_flags();
+	if (c != ParseCode::ok) return c;
+	if (call_func) {
+		if (stats) stats->calls ++;
+		Timer t(stats ? & stats->call_ns : nullptr);
+		if (!(*call_func)(key, "", call_data)) return ParseCode::callback_failed;
+	}
+	return ParseCode::ok;
+}
+
+ParseCode Option::try_process(string_view str, exception_ptr * fault)
+{
+	if (stats) stats->hits ++;
+	deferred = false; // replacing the value left by a lazy parse
+	bool caught = false;
+	if (store_ptr) {
+		if (stats) stats->sets ++;
+		Timer t(stats ? & stats->set_ns : nullptr);
+		if (! init_taken) take_init();
+		if (! store_ptr->try_set(str, fault)) return ParseCode::bad_value;
+		caught = true;
+	}
+	ParseCode c = try_flags();
+	if (c != ParseCode::ok) return c;
+	if (call_func) {
+		if (stats) stats->calls ++;
+		Timer t(stats ? & stats->call_ns : nullptr);
+		if (!(*call_func)(key, string(str), call_data)) return ParseCode::callback_failed;
+		caught = true;
+	}
+	if (!caught) return ParseCode::unwanted_value;
+	return ParseCode::ok;
+}
+
+ParseCode Option::try_flags()
+{
+	if (set_bool) *set_bool = bool_value;
+	if (set_var) {
+		if (set_once && set_init != *set_var) return ParseCode::reset;
+		*set_var = set_value;
+	}
+	return ParseCode::ok;
+}
+
+ParseCode Option::try_defer(string_view str, size_t index)
+{
+	if (stats) stats->hits ++;
+	deferred = true;
+	pending = str;
+	pending_index = index;
+	return try_flags();
+}
+
+void Option::take_init()
+{
+	init_taken = true;
+	try {
+		cold->store_init = store_ptr->to_str();
+		cold->store_known = true;
+	}
+	catch (Error &) { // not representable yet, as a SetValue without elements
+		cold->store_known = false;
+	}
+}
+
+bool Option::is_deferred() const
+{
+	return deferred;
+}
+
+ParseCode Option::try_materialize(exception_ptr * fault)
+{
+	if (! deferred) return ParseCode::ok;
+	deferred = false;
+	if (stats) stats->sets ++;
+	Timer t(stats ? & stats->set_ns : nullptr);
+	if (! init_taken) take_init();
+	return store_ptr->try_set(pending, fault) ? ParseCode::ok : ParseCode::bad_value;
+}
+
+void Option::materialize()
+{
+	string_view str = pending;
+	exception_ptr fault;
+	ParseCode c = try_materialize(& fault);
+	if (c == ParseCode::ok) return;
+	try {
+		fail(c, str, fault);
+	}
+	catch (Error & e) {
+		e.at("token " + to_string(pending_index + 1));
+		throw;
+	}
+}
+
+void Option::fail(ParseCode code, string_view str, exception_ptr fault)
+{
+	switch (code) {
+	case ParseCode::missing_value:
+		throw OptError(name, "missing value");
+	case ParseCode::unwanted_value:
+		throw OptError(name, "unwanted value '" + string(str) + "'");
+	case ParseCode::bad_value:
+		if (fault) rethrow_exception(fault); // the error of the value itself
+		throw store_ptr->conv_error(str);
+	case ParseCode::reset:
+		throw OptError(name, "can not re-set");
+	case ParseCode::callback_failed:
+		throw OptError(name, "callback error");
+	default:
+		throw OptError(name);
+	}
+}
+
+void Option::add_args(vector<string> & toks)
+{
+	bool flag = (set_bool && * set_bool == bool_value && cold->bool_init != bool_value)
+		|| (set_var && * set_var == set_value && cold->var_init != set_value);
+	if (call_func && given && ! store_ptr && ! flag) throw OptError(name.size() ? name : string(1, char(key)), "can not give back the callback");
+	string v;
+	bool valued = false;
+	if (deferred) { // the value as given
+		v = string(pending);
+		valued = true;
+	}
+	else if (store_ptr) {
+		if (! init_taken) take_init(); // unchanged since stored
+		try {
+			v = store_ptr->to_str();
+			valued = ! cold->store_known || v != cold->store_init;
+		}
+		catch (Error &) {} // no value to give
+	}
+	if (! valued && ! flag) return;
+	if (name.size()) {
+		toks.push_back("--" + name);
+		if (valued) toks.back() += "=" + v;
+		return;
+	}
+	if (key <= 0 || key > 255) return; // can not be given on command line
+	toks.push_back(string("-") + char(key));
+	if (! valued) return;
+	if (store_optional) toks.back() += v; // a value in a token of its own is not taken
+	else toks.push_back(v);
+}
+
+Argument::Argument(string const & name) :
+	name(name)
+{}
+
+Argument::~Argument() {}
+
+Argument & Argument::store(std::shared_ptr<Value> ptr)
+{
+	static auto const null_value = std::make_shared<Value>();
+	store_ptr = ptr ? ptr : null_value;
+	return * this;
+}
+
+Argument & Argument::help(string const & text)
+{
+	help_text = text;
+	return * this;
+}
+
+Argument & Argument::variadic(bool v)
+{
+	many = v;
 	return * this;
 }
 
-Option & Option::help(string const & text, string const & var)
+string const & Argument::get_name()
+{
+	return name;
+}
+
+bool Argument::is_variadic() const
+{
+	return many;
+}
+
+std::string Argument::get_help()
+{
+	string h = "    " + name;
+	if (h.size() < 26) h.resize(26, ' ');
+	h += "   ";
+	h += help_text;
+	return h;
+}
+
+void Argument::process(std::string const & str)
+{
+	if (! store_ptr) throw OptError(name, "no place to store '" + str + "'");
+	store_ptr->set(str);
+}
+
+ParseCode Argument::try_process(std::string_view str, exception_ptr * fault)
+{
+	if (! store_ptr) return ParseCode::unwanted_value;
+	return store_ptr->try_set(str, fault) ? ParseCode::ok : ParseCode::bad_value;
+}
+
+NameTrie::NameTrie() :
+	nodes(1)
+{}
+
+void NameTrie::clear()
+{
+	nodes.assign(1, Node());
+}
+
+int NameTrie::child(int n, unsigned char c) const
+{
+	auto & k = nodes[n].kids;
+	auto i = lower_bound(k.begin(), k.end(), c, [](pair<unsigned char, int> const & a, unsigned char c){return a.first < c;});
+	return i != k.end() && i->first == c ? i->second : -1;
+}
+
+int NameTrie::node(string_view prefix) const
+{
+	int n = 0;
+	for (size_t i = 0; i < prefix.size() && n >= 0; i ++) n = child(n, prefix[i]);
+	return n;
+}
+
+void NameTrie::insert(string_view name, int pos)
+{
+	int n = 0;
+	nodes[0].count ++;
+	for (unsigned char c: name) {
+		int m = child(n, c);
+		if (m < 0) {
+			m = nodes.size();
+			nodes.emplace_back();
+			auto & k = nodes[n].kids;
+			k.insert(lower_bound(k.begin(), k.end(), make_pair(c, 0)), make_pair(c, m));
+		}
+		n = m;
+		nodes[n].count ++;
+	}
+	nodes[n].pos = pos;
+}
+
+int NameTrie::match(string_view prefix) const
+{
+	int n = node(prefix);
+	if (n < 0 || ! nodes[n].count) return -1;
+	if (nodes[n].count > 1) return -2;
+	while (nodes[n].pos < 0) n = nodes[n].kids.front().second; // down the only branch
+	return nodes[n].pos;
+}
+
+void NameTrie::collect(string_view prefix, vector<int> & pos) const
+{
+	int n = node(prefix);
+	if (n < 0) return;
+	vector<int> stack{n};
+	while (stack.size()) {
+		int m = stack.back();
+		stack.pop_back();
+		if (nodes[m].pos >= 0) pos.push_back(nodes[m].pos);
+		auto & k = nodes[m].kids;
+		for (auto i = k.rbegin(); i != k.rend(); i ++) stack.push_back(i->second);
+	}
+}
+
+Parser::HelpLine::HelpLine(std::string const & m, Option * o) :
+	msg(m),
+	opt(o),
+	rev(0),
+	fresh(false)
+{}
+
+Parser::Parser() :
+	arena(std::make_shared<Arena>(4096))
+{
+	std::fill(std::begin(key_index), std::end(key_index), -1);
+}
+
+Parser::~Parser()
+{
+	if (stats.use_count() != 1) return; // counters of a copy are kept
+	// options may outlive the counters, or count for a copy that renewed them
+	unordered_set<OptionStats const *> own;
+	for (auto & s: stats->options) own.insert(& s);
+	for (auto & o: opt_list) if (own.count(o->stats)) o->stats = nullptr;
+}
+
+void Parser::index_opt(int pos)
+{
+	Option & o = * opt_list[pos];
+	int key = o.get_key();
+	bool in_table = key > 0 && key < 256;
+	bool dup = in_table ? key_index[key] >= 0 : key && wide_key_index.count(key);
+	if (dup) throw Error(string("duplicated option key: ") + (in_table && isprint(key) ? string(1, char(key)) : to_string(key)));
+	if (o.get_name() != "" && ! name_insert(o.get_name(), pos)) throw Error("duplicated option name: " + o.get_name());
+	if (in_table) key_index[key] = pos;
+	else if (key) wide_key_index.emplace(key, pos);
+	if (abbrev && o.get_name() != "") name_trie.insert(o.get_name(), pos);
+}
+
+void Parser::reindex()
+{
+	std::fill(std::begin(key_index), std::end(key_index), -1);
+	wide_key_index.clear();
+	name_slots.clear();
+	name_count = 0;
+	name_trie.clear();
+	for (size_t i = 0; i < opt_list.size(); i ++) index_opt(i);
+}
+
+Option * Parser::lookup(int key) const
+{
+	if (key > 0 && key < 256) return key_index[key] < 0 ? nullptr : opt_list[key_index[key]].get();
+	auto i = wide_key_index.find(key);
+	return i == wide_key_index.end() ? nullptr : opt_list[i->second].get();
+}
+
+int Parser::name_find(string_view name) const
+{
+	if (name_slots.empty()) return -1;
+	uint32_t h = std::hash<string_view>()(name);
+	size_t mask = name_slots.size() - 1;
+	for (size_t i = h & mask; name_slots[i].pos >= 0; i = (i + 1) & mask) { // linear probing
+		if (name_slots[i].hash == h && opt_list[name_slots[i].pos]->name == name) return name_slots[i].pos;
+	}
+	return -1;
+}
+
+bool Parser::name_insert(string_view name, int pos)
+{
+	if (name_find(name) >= 0) return false;
+	if ((name_count + 1) * 2 > name_slots.size()) { // grow and rehash
+		vector<NameSlot> old(max<size_t>(16, name_slots.size() * 2), NameSlot{0, -1});
+		old.swap(name_slots);
+		size_t mask = name_slots.size() - 1;
+		for (auto & s: old) if (s.pos >= 0) {
+			size_t i = s.hash & mask;
+			while (name_slots[i].pos >= 0) i = (i + 1) & mask;
+			name_slots[i] = s;
+		}
+	}
+	uint32_t h = std::hash<string_view>()(name);
+	size_t mask = name_slots.size() - 1;
+	size_t i = h & mask;
+	while (name_slots[i].pos >= 0) i = (i + 1) & mask;
+	name_slots[i] = NameSlot{h, pos};
+	name_count ++;
+	return true;
+}
+
+Option * Parser::lookup(std::string_view name) const
+{
+	int pos = name_find(name);
+	return pos < 0 ? nullptr : opt_list[pos].get();
+}
+
+Option * Parser::match(std::string_view name, bool & ambiguous) const
+{
+	ambiguous = false;
+	if (Option * o = lookup(name)) return o;
+	if (! abbrev || name.empty()) return nullptr;
+	int pos = name_trie.match(name);
+	ambiguous = pos == -2;
+	return pos < 0 ? nullptr : opt_list[pos].get();
+}
+
+Option * Parser::match(std::string_view name) const
+{
+	bool ambiguous;
+	Option * o = match(name, ambiguous);
+	if (ambiguous) {
+		vector<int> found;
+		name_trie.collect(name, found);
+		vector<string> names;
+		for (int i: found) names.push_back(opt_list[i]->get_name());
+		throw AmbigError(string(name), names);
+	}
+	return o;
+}
+
+void Parser::add_help(string const & msg)
+{
+	help_list.emplace_back(msg, nullptr);
+}
+
+Option & Parser::add_opt(int key, string const & name, bool hide)
+{
+	auto o = make_in<Option>(arena, key, name, arena);
+	if (stats) {
+		stats->options.push_back(OptionStats{key, name});
+		o->stats = & stats->options.back();
+	}
+	opt_list.push_back(o);
+	try {
+		index_opt(opt_list.size() - 1);
+	}
+	catch (Error &) {
+		opt_list.pop_back();
+		throw;
+	}
+	if (! hide) help_list.emplace_back("", o.get());
+	return * o;
+}
+
+Option & Parser::add_opt(string const & name, bool hide)
+{
+	return add_opt(0, name, hide);
+}
+
+Option & Parser::get_opt(std::string const & name)
+{
+	Option * o = lookup(name);
+	return o ? * o : add_opt(0, name);
+}
+
+vector<string> & Parser::args()
+{
+	if (arg_strs_stale) {
+		arg_strs.assign(arg_toks.begin(), arg_toks.end());
+		arg_strs_stale = false;
+	}
+	return arg_strs;
+}
+
+vector<string_view> const & Parser::arg_views() const
+{
+	return arg_toks;
+}
+
+Parser::Source::~Source() {}
+
+namespace { // token sources
+	// tokens from an array of c-strings
+	class ArgvSource :
+		public Parser::Source
+	{
+		char const * const * argv;
+		char const * const * end;
+	public:
+		ArgvSource(int argc, char const * const argv[]) :
+			argv(argv),
+			end(argv + argc)
+		{}
+
+		bool next(string_view & tok) override
+		{
+			if (argv == end) return false;
+			tok = * argv ++;
+			return true;
+		}
+	};
+
+	// tokens in a range of string views
+	class ViewSource :
+		public Parser::Source
+	{
+		string_view const * i;
+		string_view const * end;
+	public:
+		ViewSource(string_view const * begin, string_view const * end) :
+			i(begin),
+			end(end)
+		{}
+
+		bool next(string_view & tok) override
+		{
+			if (i == end) return false;
+			tok = * i ++;
+			return true;
+		}
+	};
+}
+
+Parser::FdSource::FdSource(int fd, char delim, size_t size, bool own) :
+	fd(fd),
+	own(own),
+	delim(delim)
+{
+	bufs[0].resize(size ? size : 1);
+}
+
+Parser::FdSource::~FdSource()
+{
+	if (own) close(fd);
+}
+
+bool Parser::FdSource::next(string_view & tok)
+{
+	for (;;) {
+		char * b = bufs[cur].data();
+		char * p = pos < end ? static_cast<char *>(memchr(b + pos, delim, end - pos)) : nullptr;
+		if (p || (eof && pos < end)) {
+			if (! p) p = b + end; // the last token without a delimiter
+			tok = string_view(b + pos, p - (b + pos));
+			pos = p - b + (p < b + end);
+			if (tok.empty() && delim == '\n') continue;
+			fresh = false;
+			return true;
+		}
+		if (eof) return false;
+		if (end == bufs[cur].size()) { // no room to read
+			size_t part = end - pos;
+			if (fresh) { // nothing handed out from this buffer, reuse it
+				memmove(b, b + pos, part);
+				if (part == bufs[cur].size()) bufs[cur].resize(part * 2);
+			}
+			else { // carry the partial token over to the other buffer, keeping the tokens handed out
+				auto & o = bufs[! cur];
+				if (o.size() < bufs[cur].size()) o.resize(bufs[cur].size());
+				memcpy(o.data(), b + pos, part);
+				cur = ! cur;
+				fresh = true;
+			}
+			pos = 0;
+			end = part;
+		}
+		ssize_t n = read(fd, bufs[cur].data() + end, bufs[cur].size() - end);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			throw Error("can not read from file descriptor " + to_string(fd));
+		}
+		if (n == 0) eof = true;
+		end += n;
+	}
+}
+
+namespace { // response files
+	// map `size` bytes of `fd` as private pages, only those written to get copied
+	shared_ptr<char> map_file(int fd, size_t size, string const & path)
+	{
+		if (! size) return nullptr;
+		void * m = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (m == MAP_FAILED) throw Error("can not map file: " + path);
+		madvise(m, size, MADV_SEQUENTIAL);
+		return shared_ptr<char>(static_cast<char *>(m), [size](char * p){munmap(p, size);});
+	}
+
+	// characters ending a plain run in a shell token: blanks, quotes and backslash
+	struct ShellStops {
+		bool stop[256] = {};
+		ShellStops()
+		{
+			for (char const * c = " \t\n\v\f\r'\"\\"; * c; c ++) stop[(unsigned char)* c] = true;
+		}
+	} const shell_stops;
+
+	// split the next shell-quoted token off [p, end), skipping leading blanks.
+	// A token with quotes or escapes is unquoted to `out`, which may alias the
+	// input as writes never overtake reads; other tokens view the input, so a
+	// caller unquoting in place has to move `out` past them to `p`.
+	bool shell_token(char const *& p, char const * end, char *& out, string_view & tok)
+	{
+		while (p != end && isspace((unsigned char)* p)) p ++;
+		if (p == end) return false;
+		char const * start = p;
+		while (p != end && ! shell_stops.stop[(unsigned char)* p]) p ++; // plain run
+		if (p == end || isspace((unsigned char)* p)) {
+			tok = string_view(start, p - start);
+			return true;
+		}
+		char * w = nullptr; // write position once unquoting
+		char q = 0; // the open quote
+		for (; p != end; p ++) {
+			char c = * p;
+			if (! q && isspace((unsigned char)c)) break;
+			bool quoting = (c == '\\' && q != '\'') || (c == '\'' && q != '"') || (c == '"' && q != '\'');
+			if (quoting && ! w) { // keep the plain part so far
+				memmove(out, start, p - start);
+				w = out + (p - start);
+			}
+			if (! quoting) {
+				if (w) * w ++ = c;
+			}
+			else if (c == '\\') {
+				if (++ p == end) throw Error("incomplete escape at end of input");
+				c = * p;
+				if (c == '\n') continue; // line continuation
+				if (q == '"' && ! strchr("$`\"\\", c)) * w ++ = '\\'; // kept in double quotes
+				* w ++ = c;
+			}
+			else q = q ? 0 : c; // opening or closing quote
+		}
+		if (q) throw Error(string("unterminated ") + q + " in input");
+		if (! w) tok = string_view(start, p - start);
+		else {
+			tok = string_view(out, w - out);
+			out = w;
+		}
+		return true;
+	}
+
+	// expand "@file" tokens from another source into the tokens in the file
+	class RspSource :
+		public Parser::Source
+	{
+		Parser::Source & base;
+		vector<shared_ptr<char>> & maps;
+		struct File {
+			char const * p; // next to tokenize
+			char const * end;
+			char * out; // for unquoting in place
+			dev_t dev;
+			ino_t ino;
+		};
+		vector<File> stack;
+
+		// map the file to the top of the stack, false if it can not be read
+		bool push(string const & path)
+		{
+			int fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0) return false;
+			struct stat st;
+			if (fstat(fd, & st) || ! S_ISREG(st.st_mode)) {
+				close(fd);
+				return false;
+			}
+			for (auto & f: stack) if (f.dev == st.st_dev && f.ino == st.st_ino) {
+				close(fd);
+				throw Error("recursive response file: " + path);
+			}
+			shared_ptr<char> m;
+			try {
+				m = map_file(fd, st.st_size, path);
+			}
+			catch (Error &) {
+				close(fd);
+				throw;
+			}
+			close(fd);
+			char * b = m.get();
+			if (m) maps.push_back(m);
+			stack.push_back(File{b, b + st.st_size, b, st.st_dev, st.st_ino});
+			return true;
+		}
+	public:
+		RspSource(Parser::Source & base, vector<shared_ptr<char>> & maps) :
+			base(base),
+			maps(maps)
+		{}
+
+		bool next(string_view & tok) override
+		{
+			for (;;) {
+				if (stack.empty()) {
+					if (! base.next(tok)) return false;
+				}
+				else {
+					File & f = stack.back();
+					if (! shell_token(f.p, f.end, f.out, tok)) {
+						stack.pop_back();
+						continue;
+					}
+					f.out += f.p - f.out; // keep the tokens viewing the file
+				}
+				if (tok.size() > 1 && tok[0] == '@' && push(string(tok.substr(1)))) continue;
+				return true;
+			}
+		}
+	};
+}
+
+namespace {
+	// shell-quoted tokens of a command line, unquoted to a separate buffer
+	class LineSource :
+		public Parser::Source
+	{
+		char const * p;
+		char const * end;
+		char * out;
+	public:
+		LineSource(string_view line, char * buf) :
+			p(line.data()),
+			end(line.data() + line.size()),
+			out(buf)
+		{}
+
+		bool next(string_view & tok) override
+		{
+			return shell_token(p, end, out, tok);
+		}
+	};
+}
+
+void Parser::complete(vector<string_view> const & words, vector<string> & out) const
+{
+	// rejoin "--name=value", which bash splits into "--name", "=" and "value"
+	vector<string> ws;
+	bool join = false;
+	for (auto w: words) {
+		if (join || (w == "=" && ws.size() && ! ws.back().compare(0, 2, "--") && ws.back().find('=') == string::npos)) {
+			ws.back() += w;
+			join = ! join;
+			continue;
+		}
+		ws.emplace_back(w);
+	}
+	if (ws.empty()) ws.emplace_back();
+	string_view cur = ws.back();
+	for (size_t i = 0; i + 1 < ws.size(); i ++) if (ws[i] == "--") return; // arguments only
+	Option const * vo = nullptr; // option taking `cur` as its value
+	string lead; // part of `cur` before the value
+	if (cur.substr(0, 2) == "--") {
+		auto k = cur.find('=');
+		if (k == string_view::npos) {
+			string_view n = cur.substr(2);
+			for (auto & o: opt_list) {
+				string const & m = o->get_name();
+				if (m.size() && ! m.compare(0, n.size(), n)) out.push_back("--" + m + (o->take_value() ? "=" : ""));
+			}
+			return;
+		}
+		bool ambiguous;
+		vo = match(cur.substr(2, k - 2), ambiguous);
+		lead = string(cur.substr(0, k + 1));
+		cur = cur.substr(k + 1);
+	}
+	else if (cur.size() && cur[0] == '-') {
+		if (cur.size() == 1) {
+			for (auto & o: opt_list) {
+				int c = o->get_key();
+				if (c > ' ' && c < 127) out.push_back(string("-") + char(c));
+			}
+			for (auto & o: opt_list) if (o->get_name().size()) out.push_back("--" + o->get_name() + (o->take_value() ? "=" : ""));
+			return;
+		}
+		for (size_t k = 1; k < cur.size(); k ++) { // the value attached to a cluster of flags
+			vo = lookup((unsigned char)cur[k]);
+			if (! vo) return;
+			if (vo->take_value()) {
+				lead = string(cur.substr(0, k + 1));
+				cur = cur.substr(k + 1);
+				break;
+			}
+			vo = nullptr;
+		}
+	}
+	else if (ws.size() > 1) { // a value following a short option
+		string_view p = ws[ws.size() - 2];
+		if (p.size() > 1 && p[0] == '-' && p[1] != '-') {
+			for (size_t k = 1; k < p.size(); k ++) {
+				Option const * o = lookup((unsigned char)p[k]);
+				if (! o || o->take_value()) {
+					if (o && k + 1 == p.size() && o->need_value()) vo = o;
+					break;
+				}
+			}
+		}
+	}
+	if (! vo || ! vo->store_ptr) return;
+	vector<string> vals;
+	vo->store_ptr->complete(cur, vals);
+	for (auto & v: vals) out.push_back(lead + v);
+}
+
+namespace {
+	// name of a shell function for completing `prog`
+	string completion_function(string const & prog)
+	{
+		string f = "_arg_complete_";
+		for (char c: prog) f += isalnum((unsigned char)c) ? c : '_';
+		return f;
+	}
+
+	// `word` quoted for a shell
+	string shell_quote(string const & word)
+	{
+		string q = "'";
+		for (char c: word) {
+			if (c == '\'') q += "'\\''";
+			else q += c;
+		}
+		return q + "'";
+	}
+
+	// whether `word` needs no quoting in a shell, as in the "#compdef" line of zsh
+	bool shell_plain(string const & word)
+	{
+		for (char c: word) if (! isalnum((unsigned char)c) && string_view("._+-").find(c) == string_view::npos) return false;
+		return word.size();
+	}
+}
+
+string Parser::get_completion_script(string const & shell) const
+{
+	string prog = prog_name.substr(prog_name.rfind('/') + 1);
+	string f = completion_function(prog);
+	if (shell == "bash") return
+		f + "()\n"
+		"{\n"
+		"	local IFS=$'\\n' cur=${COMP_WORDS[COMP_CWORD]} prev=${COMP_WORDS[COMP_CWORD-1]}\n"
+		"	COMPREPLY=($(\"${COMP_WORDS[0]}\" __complete \"${COMP_WORDS[@]:1:COMP_CWORD}\" 2>/dev/null))\n"
+		"	if [[ ${#COMPREPLY[@]} -eq 0 ]]; then\n"
+		"		COMPREPLY=($(compgen -f -- \"$cur\"))\n"
+		"		return\n"
+		"	fi\n"
+		"	[[ ${COMPREPLY[0]} == *= ]] && compopt -o nospace\n"
+		"	if [[ $cur == = ]]; then COMPREPLY=(\"${COMPREPLY[@]/#*=/=}\")\n"
+		"	elif [[ $prev == = ]]; then COMPREPLY=(\"${COMPREPLY[@]#*=}\")\n"
+		"	fi\n"
+		"}\n"
+		"complete -F " + f + " -- " + shell_quote(prog) + "\n";
+	if (shell == "zsh") return
+		(shell_plain(prog) ? "#compdef " + prog + "\n" : string()) + // unquoted, only for names needing none
+		f + "()\n"
+		"{\n"
+		"	local -a c e\n"
+		"	c=(\"${(@f)$(\"${words[1]}\" __complete \"${(@)words[2,CURRENT]}\" 2>/dev/null)}\")\n"
+		"	c=(${c:#})\n"
+		"	(( ${#c} )) || { _files; return }\n"
+		"	e=(${(M)c:#*=})\n"
+		"	c=(${c:#*=})\n"
+		"	(( ${#e} )) && compadd -Q -S '' -- $e\n"
+		"	(( ${#c} )) && compadd -Q -- $c\n"
+		"}\n"
+		"compdef " + f + " " + shell_quote(prog) + "\n";
+	throw Error("unknown shell: " + shell);
+}
+
+void Parser::answer_completion(int argc, char * argv[])
+{
+	if (! completion || argc < 2 || strcmp(argv[1], "__complete")) return;
+	vector<string_view> words(argv + 2, argv + argc);
+	vector<string> out;
+	complete(words, out);
+	string s;
+	for (auto & o: out) (s += o) += '\n';
+	fwrite(s.data(), 1, s.size(), stdout);
+	exit(0);
+}
+
+vector<string> Parser::get_argv() const
+{
+	vector<string> toks;
+	for (auto & o: opt_list) o->add_args(toks);
+	return toks;
+}
+
+void Parser::set_stats(bool enable)
+{
+	stats.reset();
+	if (enable) {
+		stats.reset(new Stats);
+		for (auto & o: opt_list) {
+			stats->options.push_back(OptionStats{o->get_key(), o->get_name()});
+			o->stats = & stats->options.back();
+		}
+	}
+	else for (auto & o: opt_list) o->stats = nullptr;
+}
+
+Stats const * Parser::get_stats()
+{
+	if (stats) stats->arena_bytes = arena->get_bytes();
+	return stats.get();
+}
+
+void Parser::set_abbreviations(bool enable)
+{
+	if (enable == abbrev) return;
+	abbrev = enable;
+	name_trie.clear();
+	if (abbrev) for (size_t i = 0; i < opt_list.size(); i ++) {
+		if (opt_list[i]->get_name() != "") name_trie.insert(opt_list[i]->get_name(), i);
+	}
+}
+
+void Parser::set_response_files(bool enable)
+{
+	rsp_files = enable;
+}
+
+void Parser::set_lazy(bool enable)
+{
+	lazy = enable;
+}
+
+void Parser::drop_pending(Option * o)
+{
+	if (o) {
+		o->deferred = false;
+		pending_opts.erase(std::remove(pending_opts.begin(), pending_opts.end(), o), pending_opts.end());
+		return;
+	}
+	for (auto p: pending_opts) p->deferred = false;
+	pending_opts.clear();
+}
+
+void Parser::materialize()
+{
+	for (size_t i = 0; i < pending_opts.size(); i ++) {
+		try {
+			pending_opts[i]->materialize();
+		}
+		catch (Error &) {
+			pending_opts.erase(pending_opts.begin(), pending_opts.begin() + i + 1);
+			throw;
+		}
+	}
+	pending_opts.clear();
+}
+
+ParseError Parser::try_materialize()
+{
+	ParseError err;
+	err.parser = this;
+	size_t i = 0;
+	for (; i < pending_opts.size(); i ++) {
+		Option * o = pending_opts[i];
+		string_view v = o->pending;
+		ParseCode c = o->try_materialize(& err.fault);
+		if (c != ParseCode::ok) {
+			err.code = c;
+			err.opt = o;
+			err.index = o->pending_index;
+			err.token = o->name;
+			err.key = o->name.empty() ? char(o->key) : 0;
+			err.value = v;
+			i ++;
+			break;
+		}
+	}
+	pending_opts.erase(pending_opts.begin(), pending_opts.begin() + i);
+	return err;
+}
+
+void Parser::parse(int argc, char * argv[], bool ignore_unknown)
+{
+	answer_completion(argc, argv);
+	prog_name = argv[0];
+	ArgvSource src(argc - 1, argv + 1); // skip program name
+	parse(src, ignore_unknown);
+}
+
+void Parser::parse(vector<string_view> const & tokens, bool ignore_unknown)
+{
+	prog_name = tokens.size() ? string(tokens[0]) : string();
+	ViewSource src(tokens.data() + (tokens.size() ? 1 : 0), tokens.data() + tokens.size());
+	parse(src, ignore_unknown);
+}
+
+void Parser::parse(string_view line, bool ignore_unknown)
+{
+	line_buf.resize(line.size()); // unquoting never grows a token
+	LineSource src(line, & line_buf[0]);
+	string_view s;
+	if (src.next(s)) prog_name.assign(s.data(), s.size());
+	else prog_name.clear();
+	parse(src, ignore_unknown);
+}
+
+void Parser::parse(Source & source, bool ignore_unknown)
+{
+	ParseError err = try_parse(source, ignore_unknown);
+	if (err) raise(err);
+}
+
+ParseError Parser::try_parse(int argc, char * argv[], bool ignore_unknown)
+{
+	answer_completion(argc, argv);
+	prog_name = argv[0];
+	ArgvSource src(argc - 1, argv + 1); // skip program name
+	return try_parse(src, ignore_unknown);
+}
+
+ParseError Parser::try_parse(vector<string_view> const & tokens, bool ignore_unknown)
+{
+	prog_name = tokens.size() ? string(tokens[0]) : string();
+	ViewSource src(tokens.data() + (tokens.size() ? 1 : 0), tokens.data() + tokens.size());
+	return try_parse(src, ignore_unknown);
+}
+
+ParseError Parser::try_parse(Source & source, bool ignore_unknown)
+{
+	Timer timer(stats ? & stats->parse_ns : nullptr);
+	if (stats) stats->parses ++;
+	start_parse();
+	RspSource rsp(source, rsp_maps);
+	Source & src = rsp_files ? rsp : source;
+	ParseError err;
+	err.parser = this;
+	size_t index = 0;
+	string_view s;
+	while (step(src, index, s, err, ignore_unknown)) {
+		if (fd_tok) { // keep a copy, the buffer is to be reused
+			fd_copies.emplace_back(s);
+			s = fd_copies.back();
+		}
+		arg_toks.push_back(s);
+		arg_index.push_back(index - 1);
+	}
+	if (err) return err;
+	if (arg_list.size()) {
+		if (! arg_count_ok(arg_toks.size())) {
+			err.code = ParseCode::argument_count;
+			return err;
+		}
+		for (size_t i = 0; i < arg_toks.size(); i ++) {
+			Argument * a = arg_at(i);
+			ParseCode c = a->try_process(arg_toks[i], & err.fault);
+			if (c != ParseCode::ok) {
+				err.code = c;
+				err.arg = a;
+				err.index = arg_index[i];
+				err.token = arg_toks[i];
+				err.value = arg_toks[i];
+				return err;
+			}
+		}
+	}
+	return err;
+}
+
+Parser::Stream::Stream(Parser & p, unique_ptr<Source> own, Source * src, bool ignore_unknown) :
+	parser(& p),
+	own(std::move(own)),
+	src(src),
+	ignore_unknown(ignore_unknown)
+{
+	if (p.stats) p.stats->parses ++;
+	p.start_parse();
+	if (p.rsp_files) {
+		rsp.reset(new RspSource(* src, p.rsp_maps));
+		this->src = rsp.get();
+	}
+}
+
+ParseError Parser::Stream::try_next()
+{
+	ParseError err;
+	err.parser = parser;
+	if (done) return err;
+	if (! parser->step(* src, index, tok, err, ignore_unknown)) {
+		done = true;
+		tok = string_view();
+		if (! err && parser->arg_list.size() && ! parser->arg_count_ok(count)) err.code = ParseCode::argument_count;
+		return err;
+	}
+	count ++;
+	if (parser->arg_list.size()) {
+		Argument * a = parser->arg_at(count - 1);
+		ParseCode c = a ? a->try_process(tok, & err.fault) : ParseCode::argument_count;
+		if (c != ParseCode::ok) {
+			done = true;
+			err.code = c;
+			err.arg = a;
+			err.index = index - 1;
+			err.token = tok;
+			err.value = tok;
+		}
+	}
+	return err;
+}
+
+bool Parser::Stream::next()
+{
+	ParseError err = try_next();
+	if (err) parser->raise(err);
+	return ! done;
+}
+
+string_view Parser::Stream::token() const
+{
+	return tok;
+}
+
+size_t Parser::Stream::position() const
+{
+	return count;
+}
+
+bool Parser::Stream::at_end() const
+{
+	return done;
+}
+
+Parser::Stream::iterator Parser::Stream::begin()
+{
+	return iterator(next() ? this : nullptr);
+}
+
+Parser::Stream::iterator Parser::Stream::end()
+{
+	return iterator();
+}
+
+Parser::Stream::iterator::iterator(Stream * s) :
+	s(s)
+{}
+
+string_view Parser::Stream::iterator::operator * () const
+{
+	return s->tok;
+}
+
+Parser::Stream::iterator & Parser::Stream::iterator::operator ++ ()
 {
-	help_text = text;
-	if (var.size()) help_var = var;
+	if (! s->next()) s = nullptr;
 	return * this;
 }
 
-Option & Option::help_word(string const & var)
+bool Parser::Stream::iterator::operator == (iterator const & i) const
 {
-	help_var = var;
-	return * this;
+	return s == i.s;
 }
 
-Option & Option::show_default(bool do_show)
+bool Parser::Stream::iterator::operator != (iterator const & i) const
 {
-	help_default = do_show;
-	return * this;
+	return s != i.s;
 }
 
-bool Option::take_value()
+Parser::Stream Parser::stream(int argc, char * argv[], bool ignore_unknown)
 {
-	return bool(store_ptr);
+	answer_completion(argc, argv);
+	prog_name = argv[0];
+	unique_ptr<Source> src(new ArgvSource(argc - 1, argv + 1)); // skip program name
+	Source * s = src.get();
+	return Stream(* this, std::move(src), s, ignore_unknown);
 }
 
-bool Option::need_value()
+Parser::Stream Parser::stream(Source & src, bool ignore_unknown)
 {
-	return store_ptr && ! store_optional;
+	return Stream(* this, nullptr, & src, ignore_unknown);
 }
 
-int Option::get_key()
+void Parser::start_parse()
 {
-	return key;
+	arg_toks.clear();
+	arg_index.clear();
+	arg_strs.clear();
+	arg_strs_stale = true;
+	drop_pending(); // their tokens are released below
+	rsp_maps.clear();
+	fd_stack.clear();
+	fd_srcs.clear();
+	fd_copies.clear();
+	parse_serial ++;
 }
 
-string const & Option::get_name()
-{
-	return name;
+namespace {
+	thread_local Parser * active_parser = nullptr; ///<parser taking tokens on this thread, for `Parser::args_from_callback`
 }
 
-string Option::get_help(HelpFormat format)
+bool Parser::step(Source & src, size_t & index, string_view & pos, ParseError & err, bool ignore_unknown)
 {
-	string h;
-	bool s = isprint(key) && ! isspace(key);
-
-	switch (format) {
-	case HF_REGULAR:
-		h = s ? (string("  -") + char(key)) : "    ";
-		if (name != "") h += (s ? ", --" : "  --") + name;
-		if (store_ptr) {
-			if (store_optional) h += "[=" + help_var + "]";
-			else h += (name == "" ? " " : "=") + help_var;
+	// this parser for the callbacks of its options while taking tokens
+	struct Active {
+		Parser * prev;
+		Active(Parser * p) : prev(active_parser) { active_parser = p; }
+		~Active() { active_parser = prev; }
+	} active(this);
+	// the failure of an option given at `index` with value `* v`, or the stored one if null, `ok` passing through
+	auto check = [&](ParseCode code, Option * o, size_t index, string_view tok, char key, string_view const * v){
+		if (code != ParseCode::ok) {
+			err.code = code;
+			err.opt = o;
+			err.index = index;
+			err.token = tok;
+			err.key = key;
+			err.value = v ? * v : o ? string_view(o->cold->store_str) : string_view();
 		}
-		if (h.size() < 26) h.resize(26, ' ');
-		h += "   ";
-		h += help_text;
-		break;
-	case HF_NODASH:
-		h = "    ";
-		if (s) h += char(key);
-		if (name != "") h += (s ? ", " : "") + name;
-		if (store_ptr) {
-			if (name == "") {
-				if (store_optional) h += " [" + help_var + "]";
-				else h += " " + help_var;
+		return code == ParseCode::ok;
+	};
+	// process option `o` given at `index` with value `* v`, or none if null, leaving the value in lazy mode
+	auto run = [&](Option * o, size_t index, string_view const * v){
+		if (! lazy || fd_tok || ! o->store_ptr || o->call_func || (! v && ! o->store_optional)) return v ? o->try_process(* v, & err.fault) : o->try_process(& err.fault);
+		if (! o->deferred) pending_opts.push_back(o);
+		return o->try_defer(v ? * v : string_view(o->cold->store_str), index);
+	};
+	// next token, a failure of the source going to `err`
+	auto next = [&](string_view & tok){
+		try {
+			for (; fd_stack.size(); fd_stack.pop_back()) {
+				if (fd_stack.back()->next(tok)) return fd_tok = true;
+			}
+			fd_tok = false;
+			return src.next(tok);
+		}
+		catch (Error & e) {
+			err.code = ParseCode::bad_input;
+			err.note = e.get_msg();
+			return false;
+		}
+	};
+	string_view s;
+	for (; next(s); index ++) {
+		if (stats) stats->tokens ++;
+		if (s.empty() || s[0] != '-') { // non-option => argument
+			pos = s;
+			index ++;
+			return true;
+		}
+		if (s.size() > 1 && s[1] == '-') { // long options
+			string_view::size_type k = s.find('=');
+			string_view n = s.substr(2, k == string_view::npos ? k : k - 2); // name
+			// find option from index
+			bool ambiguous;
+			Option * j = match(n, ambiguous);
+			if (j) {
+				j->given = parse_serial;
+				string_view v = k != string_view::npos ? s.substr(k + 1) : string_view();
+				bool ok = k != string_view::npos
+					? check(run(j, index, & v), j, index, n, 0, & v)
+					: check(run(j, index, nullptr), j, index, n, 0, nullptr);
+				if (! ok) return false;
+			}
+			else if (ambiguous || ! ignore_unknown) {
+				check(ambiguous ? ParseCode::ambiguous_option : ParseCode::unknown_option, nullptr, index, n, 0, nullptr);
+				return false;
+			}
+			continue;
+		}
+		// short options
+		for (string_view::size_type k = 1; k < s.size(); k ++) { // there can be several options in a token
+			Option * j = lookup((unsigned char)s[k]);
+			string_view key = s.substr(k, 1);
+			if (! j) {
+				if (! ignore_unknown) {
+					check(ParseCode::unknown_option, nullptr, index, key, s[k], nullptr);
+					return false;
+				}
+				break; // for unknown option ignore the rest of the token
+			}
+			j->given = parse_serial;
+			if (! j->take_value()) { // no value allowed
+				if (! check(run(j, index, nullptr), j, index, key, s[k], nullptr)) return false;
+				continue;
+			}
+			// value allowed, it could follow
+			if (k + 1 < s.size()) {
+				string_view v = s.substr(k + 1);
+				if (! check(run(j, index, & v), j, index, key, s[k], & v)) return false;
+				break;
+			}
+			string_view v;
+			if (! j->need_value() || ! next(v)) {
+				if (err) return false; // of the source
+				if (! check(run(j, index, nullptr), j, index, key, s[k], nullptr)) return false;
 			}
 			else {
-				if (store_optional) h += "[=" + help_var + "]";
-				else h += "=" + help_var;
+				if (stats) stats->tokens ++;
+				if (! check(run(j, index, & v), j, index, key, s[k], & v)) return false;
+				index ++; // the value token
 			}
+			break;
 		}
-		if (h.size() < 26) h.resize(26, ' ');
-		h += "   ";
-		h += help_text;
-		break;
 	}
-	if (help_default && store_ptr) { // append " (default: ...)" to help
-		h += " (default: ";
-		h += store_ptr->to_str();
-		h += ")";
-	}
-	return h;
+	return false;
 }
 
-void Option::process()
+Argument * Parser::arg_at(size_t i) const
 {
-	if (store_ptr) {
-		if (!store_optional) throw OptError(name, "missing value");
-		store_ptr->set(store_str); // use default value
-	}
-	if (set_bool) *set_bool = bool_value;
-	if (set_var) {
-		if (set_once && set_init != *set_var) throw OptError(name, "can not re-set");
-		*set_var = set_value;
-	}
-	if (call_func) if (!(*call_func)(key, "", call_data)) throw OptError(name, "callback error");
+	if (i < arg_list.size()) return arg_list[i].get();
+	if (arg_list.size() && arg_list.back()->many) return arg_list.back().get();
+	return nullptr;
 }
 
-void Option::process(string const & str)
+bool Parser::arg_count_ok(size_t n) const
 {
-	bool caught = false;
-	if (store_ptr) {
-		try {
-			store_ptr->set(str);
-			caught = true;
+	if (arg_list.size() && arg_list.back()->many) return n >= arg_list.size();
+	return n == arg_list.size();
+}
+
+void Parser::raise(ParseError const & err) const
+{
+	switch (err.code) {
+	case ParseCode::ok:
+		throw Error("no error");
+	case ParseCode::unknown_option:
+	case ParseCode::ambiguous_option:
+		if (err.key) throw UnknError(string("-") + err.key);
+		if (err.code == ParseCode::ambiguous_option) match(err.token); // throws AmbigError
+		throw UnknError(string(err.token));
+	case ParseCode::argument_count:
+		throw Error("number of arguments mismatch");
+	case ParseCode::bad_input:
+		throw Error(err.note);
+	default:
+		if (err.arg) {
+			if (err.fault) rethrow_exception(err.fault); // the error of the argument
+			if (err.code == ParseCode::unwanted_value) throw OptError(err.arg->get_name(), "no place to store '" + string(err.value) + "'");
+			throw ConvError(string(err.value), err.arg->get_name());
 		}
-		catch (OptError e) {}
+		if (err.opt) err.opt->fail(err.code, err.value, err.fault);
+		throw Error(err.message());
 	}
-	if (set_bool) *set_bool = bool_value;
-	if (set_var) {
-		if (set_once && set_init != *set_var) throw OptError(name, "can not re-set");
-		*set_var = set_value;
+}
+
+ParseError::operator bool() const
+{
+	return code != ParseCode::ok;
+}
+
+string ParseError::message() const
+{
+	string name = opt ? opt->get_name() : string();
+	if (opt && name.empty()) name = string(1, char(opt->get_key()));
+	switch (code) {
+	case ParseCode::ok:
+		return string();
+	case ParseCode::unknown_option:
+		return "unknown option: " + (key ? string("-") + key : string(token));
+	case ParseCode::ambiguous_option: {
+		vector<int> found;
+		parser->name_trie.collect(token, found);
+		string m = "ambiguous option: " + string(token) + " (could be";
+		for (size_t i = 0; i < found.size(); i ++) m += (i ? ", " : " ") + parser->opt_list[found[i]]->get_name();
+		return m + ")";
 	}
-	if (call_func) {
-		if (!(*call_func)(key, str, call_data)) throw OptError(name, "callback error");
-		else caught = true;
+	case ParseCode::missing_value:
+		return "missing value for option: " + name;
+	case ParseCode::unwanted_value:
+		if (arg) return "no place to store '" + string(value) + "' for option: " + arg->get_name();
+		return "unwanted value '" + string(value) + "' for option: " + name;
+	case ParseCode::bad_value:
+		return "error converting '" + string(value) + "' to " + (opt ? opt->store_ptr : arg->store_ptr)->get_type();
+	case ParseCode::reset:
+		return "can not re-set for option: " + name;
+	case ParseCode::callback_failed:
+		return "callback error for option: " + name;
+	case ParseCode::argument_count:
+		return "number of arguments mismatch";
+	case ParseCode::bad_input:
+		return note;
 	}
-	if (!caught) throw OptError(name, "unwanted value '" + str + "'");
+	return string();
 }
 
-Argument::Argument(string const & name) :
-	name(name)
+ParseResult::ParseResult(Parser const & p) :
+	parser(& p)
 {}
 
-Argument::~Argument() {}
+string_view ParseResult::prog() const
+{
+	return prog_view;
+}
 
-Argument & Argument::store(std::shared_ptr<Value> ptr)
+vector<string_view> const & ParseResult::args() const
 {
-	store_ptr = ptr ? ptr : std::make_shared<Value>();
-	return * this;
+	return arg_views;
 }
 
-Argument & Argument::help(string const & text)
+vector<ParseResult::Occurrence> const & ParseResult::occurrences() const
 {
-	help_text = text;
-	return * this;
+	return occ_list;
 }
 
-string const & Argument::get_name()
+size_t ParseResult::count(int key) const
 {
-	return name;
+	Option const * o = parser->lookup(key);
+	return o ? std::count_if(occ_list.begin(), occ_list.end(), [o](Occurrence const & i){return i.opt == o;}) : 0;
 }
 
-std::string Argument::get_help()
+size_t ParseResult::count(string_view name) const
 {
-	string h = "    " + name;
-	if (h.size() < 26) h.resize(26, ' ');
-	h += "   ";
-	h += help_text;
-	return h;
+	Option const * o = parser->lookup(name);
+	return o ? std::count_if(occ_list.begin(), occ_list.end(), [o](Occurrence const & i){return i.opt == o;}) : 0;
 }
 
-void Argument::process(std::string const & str)
+ParseResult::Occurrence const * ParseResult::last(int key) const
 {
-	if (! store_ptr) throw OptError(name, "no place to store '" + str + "'");
-	store_ptr->set(str);
+	Option const * o = parser->lookup(key);
+	if (o) for (auto i = occ_list.rbegin(); i != occ_list.rend(); i ++) if (i->opt == o) return & * i;
+	return nullptr;
 }
 
-Parser::HelpLine::HelpLine(std::string const & m, std::shared_ptr<Option> o) :
-	msg(m),
-	opt(o)
-{}
+ParseResult::Occurrence const * ParseResult::last(string_view name) const
+{
+	Option const * o = parser->lookup(name);
+	if (o) for (auto i = occ_list.rbegin(); i != occ_list.rend(); i ++) if (i->opt == o) return & * i;
+	return nullptr;
+}
 
-Parser::~Parser() {}
+ParseResult Parser::scan(int argc, char const * const argv[], bool ignore_unknown) const
+{
+	ParseResult res(* this);
+	res.prog_view = argv[0];
+	res.arg_views.reserve(argc - 1);
+	res.occ_list.reserve(argc - 1);
+	ArgvSource src(argc - 1, argv + 1); // skip program name
+	scan(src, res, ignore_unknown);
+	return res;
+}
 
-void Parser::add_help(string const & msg)
+ParseResult Parser::scan(vector<string_view> const & tokens, bool ignore_unknown) const
 {
-	help_list.emplace_back(msg, nullptr);
+	ParseResult res(* this);
+	if (tokens.size()) {
+		res.prog_view = tokens[0];
+		res.arg_views.reserve(tokens.size() - 1);
+		res.occ_list.reserve(tokens.size() - 1);
+	}
+	ViewSource src(tokens.data() + (tokens.size() ? 1 : 0), tokens.data() + tokens.size());
+	scan(src, res, ignore_unknown);
+	return res;
 }
 
-Option & Parser::add_opt(int key, string const & name, bool hide)
+ParseResult Parser::scan(string_view line, bool ignore_unknown) const
 {
-	auto o = std::make_shared<Option>(key, name);
-	opt_list.push_back(o);
-	if (! hide) help_list.emplace_back("", o);
-	return * o;
+	ParseResult res(* this);
+	scan(line, res, ignore_unknown);
+	return res;
 }
 
-Option & Parser::add_opt(string const & name, bool hide)
+void Parser::scan(string_view line, ParseResult & res, bool ignore_unknown) const
 {
-	return add_opt(0, name, hide);
+	if (ParseError err = try_scan(line, res, ignore_unknown)) raise(err);
 }
 
-Option & Parser::get_opt(std::string const & name)
+void Parser::scan(Source & source, ParseResult & res, bool ignore_unknown) const
 {
-	for (auto & i: opt_list) if (i->get_name() == name) return * i;
-	return add_opt(0, name);
+	if (ParseError err = try_scan(source, res, ignore_unknown)) raise(err);
 }
 
-vector<string> & Parser::args()
+ParseError Parser::try_scan(string_view line, ParseResult & res, bool ignore_unknown) const
 {
-	return arg_strs;
+	res.line_buf.resize(line.size()); // unquoting never grows a token
+	LineSource src(line, & res.line_buf[0]);
+	string_view s;
+	try {
+		res.prog_view = src.next(s) ? s : string_view();
+	}
+	catch (Error & e) {
+		ParseError err;
+		err.parser = this;
+		err.code = ParseCode::bad_input;
+		err.note = e.get_msg();
+		return err;
+	}
+	return try_scan(src, res, ignore_unknown);
 }
 
-void Parser::parse(int argc, char * argv[], bool ignore_unknown)
+ParseError Parser::try_scan(Source & source, ParseResult & res, bool ignore_unknown) const
 {
-	arg_strs.clear();
-	prog_name = argv[0];
-	for (int i = 1; i < argc; i ++) { // skip program name
-		string s = argv[i];
-		if (s[0] != '-') { // non-option => argument
-			arg_strs.push_back(s);
+	res.parser = this;
+	res.arg_views.clear();
+	res.occ_list.clear();
+	res.maps.clear();
+	RspSource rsp(source, res.maps);
+	Source & src = rsp_files ? rsp : source;
+	ParseError err;
+	err.parser = this;
+	// the failure of an option given at `index`
+	auto fail = [&](ParseCode code, Option * o, size_t index, string_view tok, char key, string_view value){
+		err.code = code;
+		err.opt = o;
+		err.index = index;
+		err.token = tok;
+		err.key = key;
+		err.value = value;
+		return err;
+	};
+	// next token, a failure of the source going to `err`
+	auto next = [&](string_view & tok){
+		try {
+			return src.next(tok);
+		}
+		catch (Error & e) {
+			err.code = ParseCode::bad_input;
+			err.note = e.get_msg();
+			return false;
+		}
+	};
+	// occurrence of `o` with value `* v`, or none if null, as `Option::process` would take it
+	auto occur = [](Option const * o, size_t index, string_view const * v){
+		return v ? ParseResult::Occurrence{o, * v, true, index} : ParseResult::Occurrence{o, o->cold->store_str, o->take_value(), index};
+	};
+	string_view s;
+	for (size_t index = 0; next(s); index ++) {
+		if (s.empty() || s[0] != '-') { // non-option => argument
+			res.arg_views.push_back(s);
 			continue;
 		}
-		if (s[1] == '-') { // long options
-			string n; // name
-			string v; // value
-			bool vp = false; // value exists?
-			string::size_type k = s.find('=');
-			if (k != string::npos) { // value present
-				n = s.substr(2, k - 2);
-				v = s.substr(k + 1);
-				vp = true;
-			} else {
-				n = s.substr(2);
+		if (s.size() > 1 && s[1] == '-') { // long options
+			string_view::size_type k = s.find('=');
+			string_view n = s.substr(2, k == string_view::npos ? k : k - 2); // name
+			bool ambiguous;
+			Option * j = match(n, ambiguous);
+			if (j) {
+				string_view v = k != string_view::npos ? s.substr(k + 1) : string_view();
+				if (k != string_view::npos && ! j->take_value() && ! j->call_func) return fail(ParseCode::unwanted_value, j, index, n, 0, v);
+				if (k == string_view::npos && j->need_value()) return fail(ParseCode::missing_value, j, index, n, 0, j->cold->store_str);
+				res.occ_list.push_back(occur(j, index, k != string_view::npos ? & v : nullptr));
 			}
-			// find option from list
-			auto j = std::find_if(opt_list.begin(), opt_list.end(), [&n](std::shared_ptr<Option> x){return x->get_name() == n;});
-			if (j != opt_list.end()) {
-				if (vp) (*j)->process(v);
-				else (*j)->process(v);
+			else if (ambiguous || ! ignore_unknown) {
+				return fail(ambiguous ? ParseCode::ambiguous_option : ParseCode::unknown_option, nullptr, index, n, 0, string_view());
 			}
-			else if (! ignore_unknown) throw UnknError(n);
 			continue;
 		}
 		// short options
-		for (string::size_type k = 1; k < s.length(); k ++) { // there can be several options in a token
-			auto j = std::find_if(opt_list.begin(), opt_list.end(), [&s,k](shared_ptr<Option> x){return x->get_key() == s[k];});
-			if (j == opt_list.end()) {
-				if (! ignore_unknown) throw UnknError(string("-") + s[k]);
+		for (string_view::size_type k = 1; k < s.size(); k ++) { // there can be several options in a token
+			Option * j = lookup((unsigned char)s[k]);
+			string_view key = s.substr(k, 1);
+			if (! j) {
+				if (! ignore_unknown) return fail(ParseCode::unknown_option, nullptr, index, key, s[k], string_view());
 				break; // for unknown option ignore the rest of the token
 			}
+			if (! j->take_value()) { // no value allowed
+				res.occ_list.push_back(occur(j, index, nullptr));
+				continue;
+			}
+			// value allowed, it could follow
+			string_view v;
+			if (k + 1 < s.size()) {
+				v = s.substr(k + 1);
+				res.occ_list.push_back(occur(j, index, & v));
+			}
+			else if (! j->need_value() || ! next(v)) {
+				if (err) return err; // of the source
+				if (j->need_value()) return fail(ParseCode::missing_value, j, index, key, s[k], j->cold->store_str);
+				res.occ_list.push_back(occur(j, index, nullptr));
+			}
 			else {
-				if (! (* j)->take_value()) { // no value allowed
-					(* j)->process();
-					continue;
-				}
-				// value allowed, it could follow
-				string v = s.substr(k + 1);
-				if (v != "") {
-					(* j)->process(v);
-					break;
-				}
-				if (! (* j)->need_value() || ++ i >= argc) {
-					(* j)->process();
-					break;
-				} else (* j)->process(argv[i]);
-				break;
+				res.occ_list.push_back(occur(j, index, & v));
+				index ++; // the value token
 			}
+			break;
 		}
 	}
-	if (arg_list.size()) {
-		if (arg_list.size() != arg_strs.size()) throw Error("number of arguments mismatch");
-		for (size_t i = 0; i < arg_list.size(); i ++) arg_list[i]->process(arg_strs[i]);
+	if (err) return err; // of the source
+	if (arg_list.size() && ! arg_count_ok(res.arg_views.size())) err.code = ParseCode::argument_count;
+	return err;
+}
+
+namespace { // configuration files
+	string_view trim(string_view s)
+	{
+		while (s.size() && isspace((unsigned char)s.front())) s.remove_prefix(1);
+		while (s.size() && isspace((unsigned char)s.back())) s.remove_suffix(1);
+		return s;
+	}
+}
+
+void Parser::parse_config(string const & path, bool ignore_unknown)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) throw Error("can not open config file: " + path);
+	struct stat st;
+	shared_ptr<char> m;
+	try {
+		if (fstat(fd, & st)) throw Error("can not read config file: " + path);
+		m = map_file(fd, st.st_size, path);
+	}
+	catch (Error &) {
+		close(fd);
+		throw;
+	}
+	close(fd);
+	parse_config(string_view(m.get(), m ? st.st_size : 0), path, ignore_unknown);
+}
+
+void Parser::parse_config(string_view text, string const & name, bool ignore_unknown)
+{
+	string key; // name with section prefix, reused for every line
+	string value; // reused for every line
+	string::size_type prefix = 0; // length of the section prefix
+	int line = 0;
+	char const * p = text.data();
+	char const * end = p + text.size();
+	while (p < end) {
+		char const * e = static_cast<char const *>(memchr(p, '\n', end - p));
+		if (! e) e = end;
+		string_view l = trim(string_view(p, e - p));
+		p = e + 1;
+		line ++;
+		if (l.empty() || l[0] == '#' || l[0] == ';') continue; // comments
+		try {
+			if (l[0] == '[') { // section header
+				if (l.back() != ']') throw Error("missing ']' in section header");
+				key.assign(trim(l.substr(1, l.size() - 2)));
+				if (key.size()) key += '.';
+				prefix = key.size();
+				continue;
+			}
+			string_view::size_type k = l.find('=');
+			key.resize(prefix);
+			key.append(trim(l.substr(0, k)));
+			Option * o = lookup(key);
+			if (! o) {
+				if (ignore_unknown) continue;
+				throw UnknError(key);
+			}
+			if (o->given && o->given == parse_serial) continue; // the command line takes precedence
+			if (k == string_view::npos) o->process();
+			else {
+				string_view v = trim(l.substr(k + 1));
+				if (v.size() > 1 && v.front() == '"' && v.back() == '"') v = v.substr(1, v.size() - 2);
+				value.assign(v);
+				o->process(value);
+			}
+		}
+		catch (Error & err) {
+			err.at(name + ':' + to_string(line));
+			throw;
+		}
+	}
+}
+
+void Parser::parse_env(char const * const * envp)
+{
+	if (! envp) envp = environ;
+	// bound options by variable
+	deque<string> names; // derived names, never moved
+	unordered_map<string_view, Option *> index;
+	index.reserve(opt_list.size());
+	for (auto & o: opt_list) {
+		auto & c = * o->cold;
+		if (! c.env_bound) continue;
+		string_view v = c.env_var;
+		if (v.empty()) {
+			string n = env_prefix;
+			for (char ch: o->get_name()) n += isalnum((unsigned char)ch) ? toupper((unsigned char)ch) : '_';
+			names.push_back(n);
+			v = names.back();
+		}
+		if (! index.emplace(v, o.get()).second) throw Error("duplicated environment variable: " + string(v));
+	}
+	if (index.empty()) return;
+	if (! parse_serial) parse_serial ++; // for marking options as given
+	for (; * envp; envp ++) {
+		string_view e = * envp;
+		auto k = e.find('=');
+		if (k == string_view::npos) continue;
+		auto i = index.find(e.substr(0, k));
+		if (i == index.end()) continue;
+		Option * o = i->second;
+		if (o->given == parse_serial) continue; // the command line takes precedence
+		string_view v = e.substr(k + 1);
+		try {
+			if (o->take_value()) o->process(string(v));
+			else if (v.size() && v != "0" && v != "false" && v != "no" && v != "off") o->process();
+			else continue; // a flag not given
+		}
+		catch (Error & err) {
+			err.at(string(i->first));
+			throw;
+		}
+		o->given = parse_serial;
 	}
 }
 
+void Parser::set_env_prefix(string const & prefix)
+{
+	env_prefix = prefix;
+}
+
 void Parser::set_header(std::string const & text)
 {
 	header_text = text;
@@ -364,14 +2041,19 @@ string const & Parser::get_header() const
 
 std::shared_ptr<Option> Parser::find(int key)
 {
-	for (auto j: opt_list) if (j->get_key() == key) return j;
+	if (key > 0 && key < 256) return key_index[key] < 0 ? nullptr : opt_list[key_index[key]];
+	if (key) {
+		auto i = wide_key_index.find(key);
+		return i == wide_key_index.end() ? nullptr : opt_list[i->second];
+	}
+	for (auto & j: opt_list) if (j->get_key() == key) return j; // the first option without a key
 	return nullptr;
 }
 
 std::shared_ptr<Option> Parser::find(std::string const & name)
 {
-	for (auto j: opt_list) if (j->get_name() == name) return j;
-	return nullptr;
+	int pos = name_find(name);
+	return pos < 0 ? nullptr : opt_list[pos];
 }
 
 void Parser::remove(int key)
@@ -381,9 +2063,13 @@ void Parser::remove(int key)
 		return h.opt && h.opt->get_key() == key;
 	}), help_list.end());
 	// erase the option itself
-	opt_list.erase(std::remove_if(opt_list.begin(), opt_list.end(), [key](std::shared_ptr<Option> x){
-		return x->get_key() == key;
+	opt_list.erase(std::remove_if(opt_list.begin(), opt_list.end(), [this, key](std::shared_ptr<Option> const & x){
+		if (x->get_key() != key) return false;
+		x->stats = nullptr; // counters go with the parser
+		drop_pending(x.get());
+		return true;
 	}), opt_list.end());
+	reindex();
 }
 
 void Parser::remove(std::string const & name)
@@ -393,18 +2079,107 @@ void Parser::remove(std::string const & name)
 		return l.opt && l.opt->get_name() == name;
 	}), help_list.end());
 	// erase the option itself
-	opt_list.erase(std::remove_if(opt_list.begin(), opt_list.end(), [&](std::shared_ptr<Option> x){
-		return x->get_name() == name;
+	opt_list.erase(std::remove_if(opt_list.begin(), opt_list.end(), [&](std::shared_ptr<Option> const & x){
+		if (x->get_name() != name) return false;
+		x->stats = nullptr; // counters go with the parser
+		drop_pending(x.get());
+		return true;
 	}), opt_list.end());
+	reindex();
 }
 
 void Parser::remove_all()
 {
 	help_list.clear();
+	for (auto & o: opt_list) o->stats = nullptr; // counters go with the parser
+	drop_pending();
 	opt_list.clear();
+	reindex();
 }
 
-string Parser::get_help()
+namespace { // help rendering
+	// append `body` to `h`, wrapping at `width` with following lines indented to where `body` starts
+	void wrap(string & h, string_view body, size_t width)
+	{
+		size_t indent = h.size();
+		if (! width || indent + body.size() <= width || indent + 20 > width) { // fits or too narrow to wrap
+			h += body;
+			return;
+		}
+		while (body.size() > width - indent) {
+			size_t k = body.rfind(' ', width - indent);
+			if (k == string_view::npos || k == 0) k = body.find(' ', width - indent); // a long word
+			if (k == string_view::npos) break;
+			h += body.substr(0, k);
+			h += '\n';
+			h.append(indent, ' ');
+			body.remove_prefix(k);
+			while (body.size() && body[0] == ' ') body.remove_prefix(1);
+		}
+		h += body;
+	}
+
+	// pieces of output gathered for writev
+	class IoBatch
+	{
+		int fd;
+		vector<iovec> iov;
+#ifdef IOV_MAX
+		static size_t const max = IOV_MAX;
+#else
+		static size_t const max = 16;
+#endif
+	public:
+		IoBatch(int fd) :
+			fd(fd)
+		{
+			iov.reserve(max);
+		}
+
+		void add(string_view s)
+		{
+			if (s.empty()) return;
+			iov.push_back(iovec{const_cast<char *>(s.data()), s.size()});
+			if (iov.size() == max) flush();
+		}
+
+		void flush()
+		{
+			size_t i = 0;
+			while (i < iov.size()) {
+				ssize_t n = writev(fd, iov.data() + i, iov.size() - i);
+				if (n < 0) {
+					if (errno == EINTR) continue;
+					throw Error("can not write help");
+				}
+				for (; i < iov.size() && size_t(n) >= iov[i].iov_len; i ++) n -= iov[i].iov_len;
+				if (n) { // partially written
+					iov[i].iov_base = static_cast<char *>(iov[i].iov_base) + n;
+					iov[i].iov_len -= n;
+				}
+			}
+			iov.clear();
+		}
+	};
+}
+
+void Parser::render_help(int width)
+{
+	bool all = width != help_width;
+	help_width = width;
+	for (auto & l: help_list) {
+		if (! l.opt || (l.fresh && ! all && l.rev == l.opt->cold->rev && ! l.opt->cold->help_default)) continue; // a shown default may have changed
+		string h = l.opt->get_help_head();
+		if (h.size() < 26) h.resize(26, ' ');
+		h += "   ";
+		wrap(h, l.opt->get_help_body(), width);
+		l.text.swap(h);
+		l.rev = l.opt->cold->rev;
+		l.fresh = true;
+	}
+}
+
+string Parser::get_usage()
 {
 	string h;
 	if (arg_list.size()) {
@@ -412,17 +2187,16 @@ string Parser::get_help()
 		h += prog_name + " [Options]";
 		for (auto i = arg_list.begin(); i != arg_list.end(); i ++) {
 			h += " " + (* i)->get_name();
+			if ((* i)->many) h += "...";
 		}
 		h += "\n\n";
 	}
-	if (help_list.size()) h += " Valid options are:\n\n";
-	for (auto i = help_list.begin(); i != help_list.end(); i ++) {
-		h += i->msg;
-		if (i->opt) {
-			h += i->opt->get_help();
-		}
-		h += '\n';
-	}
+	return h;
+}
+
+string Parser::get_arg_help()
+{
+	string h;
 	if (arg_list.size()) {
 		h += "\n Required argument";
 		if (arg_list.size() > 1) h += 's';
@@ -435,13 +2209,67 @@ string Parser::get_help()
 	return h;
 }
 
+string Parser::get_help()
+{
+	Timer timer(stats ? & stats->help_ns : nullptr);
+	if (stats) stats->helps ++;
+	render_help(0);
+	string h = get_usage();
+	if (help_list.size()) h += " Valid options are:\n\n";
+	for (auto & l: help_list) {
+		h += l.msg;
+		if (l.opt) h += l.text;
+		h += '\n';
+	}
+	h += get_arg_help();
+	return h;
+}
+
+void Parser::write_help(int fd, int width)
+{
+	Timer timer(stats ? & stats->help_ns : nullptr);
+	if (stats) stats->helps ++;
+	if (width < 0) {
+		struct winsize ws;
+		width = isatty(fd) && ioctl(fd, TIOCGWINSZ, & ws) == 0 ? ws.ws_col : 0;
+	}
+	render_help(width);
+	string usage = get_usage();
+	string args = get_arg_help();
+	IoBatch out(fd);
+	out.add(usage);
+	if (help_list.size()) out.add(" Valid options are:\n\n");
+	for (auto & l: help_list) {
+		out.add(l.msg);
+		if (l.opt) out.add(l.text);
+		out.add("\n");
+	}
+	out.add(args);
+	out.flush();
+}
+
+bool Parser::args_from_callback(int, string const & path, void * data)
+{
+	ArgsFrom * a = static_cast<ArgsFrom *>(data);
+	Parser * p = active_parser; // not the one adding the option, which a copy may be parsing
+	if (! p) throw Error("arguments can only be read from files on the command line");
+	int fd = STDIN_FILENO;
+	if (path != "-") {
+		fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) throw Error("can not open file: " + path);
+	}
+	p->fd_srcs.emplace_back(new FdSource(fd, a->delim, 65536, fd != STDIN_FILENO));
+	p->fd_stack.push_back(p->fd_srcs.back().get());
+	return true;
+}
+
 namespace { // local callback functions
 	bool help_callback(int, string const &, void * data)
 	{
 		Parser * p = static_cast<Parser *>(data);
 		cout << p->get_header();
-		cout << '\n';
-		cout << p->get_help();
+		cout << '\n' << flush;
+		p->write_help(STDOUT_FILENO);
 		cout << '\n';
 		exit(0);
 	}
@@ -452,6 +2280,13 @@ namespace { // local callback functions
 		cout << * s << '\n';
 		exit(0);
 	}
+
+	bool completion_callback(int, string const & shell, void * data)
+	{
+		Parser * p = static_cast<Parser *>(data);
+		cout << p->get_completion_script(shell);
+		exit(0);
+	}
 }
 
 Option & Parser::add_opt_help()
@@ -461,6 +2296,24 @@ Option & Parser::add_opt_help()
 		.help("display this help list and exit");
 }
 
+Option & Parser::add_opt_args_from(char delim, string const & name)
+{
+	args_from.push_back(make_shared<ArgsFrom>(ArgsFrom{delim}));
+	return add_opt(name)
+		.call(& args_from_callback, args_from.back().get())
+		.help(delim == '\n'
+			? "read further arguments from FILE, one per line, or from standard input for -"
+			: "read further arguments from FILE, each ended by a null, or from standard input for -", "FILE");
+}
+
+Option & Parser::add_opt_completion()
+{
+	completion = true;
+	return add_opt("completion")
+		.call(& completion_callback, this)
+		.help("print a script completing the program in SHELL, bash or zsh, and exit", "SHELL");
+}
+
 Option & Parser::add_opt_version(string const & ver)
 {
 	version_info = ver;
@@ -471,41 +2324,50 @@ Option & Parser::add_opt_version(string const & ver)
 
 Argument & Parser::add_arg(string const & name)
 {
-	arg_list.emplace_back(std::make_shared<Argument>(name));
+	arg_list.push_back(make_in<Argument>(arena, name));
+	arg_list.back()->arena = arena;
 	return * arg_list.back();
 }
 
 SubParser::SubParser() :
-	sep(',')
+	sep(','),
+	assign('=')
 {
 }
 
 void SubParser::set(string const & str)
 {
-	string name;
-	string value;
-	int s = 0;
-	string::size_type n = string::npos;
-	for (string::size_type k = 0; k < str.length(); k ++) {
-		if (str[k] == '=') n = k;
-		if (k + 1 == str.length() || str[k + 1] == sep) {
-			if (n == string::npos) n = k + 1;
-			name = str.substr(s, n - s);
-
-			auto j = std::find_if(opt_list.begin(), opt_list.end(), [name](std::shared_ptr<Option> x){
-				return x->get_name() == name;
-			});
-			if (j == opt_list.end()) throw UnknError(name);
-
-			if (n < k + 1) {
-				value = str.substr(n + 1, k - n);
-				(* j)->process(value);
-			} else (* j)->process();
-			k ++;
-			s = k + 1;
-			n = string::npos;
+	char const * p = str.data();
+	char const * end = p + str.size();
+	while (p < end) {
+		char const * e = static_cast<char const *>(memchr(p, sep, end - p));
+		if (! e) e = end;
+		if (e != p) { // skip empty fields
+			char const * a = static_cast<char const *>(memchr(p, assign, e - p));
+			string_view name(p, (a ? a : e) - p);
+			Option * j = match(name);
+			if (! j) throw UnknError(string(name));
+			if (a) {
+				value_buf.assign(a + 1, e); // reuses capacity from earlier pairs
+				j->process(value_buf);
+			}
+			else j->process();
 		}
+		p = e + 1;
+	}
+}
+
+string SubParser::to_str() const
+{
+	string s;
+	for (auto & t: get_argv()) { // "--name" or "--name=value", those without a name can not be set here
+		if (t.compare(0, 2, "--")) continue;
+		string::size_type k = t.find('=');
+		if (s.size()) s += sep;
+		if (k == string::npos) s.append(t, 2, string::npos);
+		else s.append(t, 2, k - 2).append(1, assign).append(t, k + 1, string::npos);
 	}
+	return s;
 }
 
 string SubParser::get_help()
@@ -530,6 +2392,16 @@ namespace { // local callback functions
 	}
 }
 
+void SubParser::set_sep(char s)
+{
+	sep = s;
+}
+
+void SubParser::set_assign(char a)
+{
+	assign = a;
+}
+
 Option & SubParser::add_opt_help()
 {
 	return add_opt("help")
@@ -549,6 +2421,12 @@ string Error::get_msg()
 	return msg;
 }
 
+Error & Error::at(string const & where)
+{
+	msg = where + ": " + msg;
+	return * this;
+}
+
 OptError::OptError(string const & o)
 {
 	opt = o;
@@ -571,6 +2449,19 @@ UnknError::UnknError(string const & o)
 	msg = "unknown option: " + o;
 }
 
+AmbigError::AmbigError(string const & o, vector<string> const & candidates) :
+	names(candidates)
+{
+	msg = "ambiguous option: " + o + " (could be";
+	for (size_t i = 0; i < names.size(); i ++) msg += (i ? ", " : " ") + names[i];
+	msg += ")";
+}
+
+vector<string> const & AmbigError::get_candidates() const
+{
+	return names;
+}
+
 MissingError::MissingError(string const & type)
 {
 	msg = "missing an argument of type " + type;
@@ -21,18 +21,147 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <charconv>
+#include <cctype>
+#include <type_traits>
+#include <string_view>
 #include <sstream>
 #include <typeinfo>
 #include <memory>
+#include <exception>
+#include <memory_resource>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <iterator>
+#include <utility>
 namespace arg {
+	class ConvError;
+
 	/// proxy to values of command line options, need to know where to store the values
 	class Value
 	{
 	public:
 		virtual ~Value();
 		virtual void set(std::string const & str); ///<convert the str to value and put it in storage
+		virtual bool try_set(std::string_view str, std::exception_ptr * fault = nullptr); ///<as `set` but returning `false` instead of throwing an Error, which goes to `* fault` if given
 		virtual std::string to_str() const; ///<convert the value to a string
 		virtual std::string get_type() const; ///<type name of the value
+		virtual ConvError conv_error(std::string_view str) const; ///<the Error of `set` for a `str` that `try_set` rejected without giving one, made only when reported
+		virtual void complete(std::string_view prefix, std::vector<std::string> & out) const; ///<append the values starting with `prefix`, none if not enumerable
+	};
+
+	/// allocator drawing from a shared memory resource, which it keeps alive
+	template <typename T>
+	class ArenaAllocator
+	{
+		template <typename U> friend class ArenaAllocator;
+		std::shared_ptr<std::pmr::memory_resource> res;
+	public:
+		typedef T value_type;
+
+		ArenaAllocator(std::shared_ptr<std::pmr::memory_resource> r) :
+			res(std::move(r))
+		{}
+
+		template <typename U>
+		ArenaAllocator(ArenaAllocator<U> const & a) :
+			res(a.res)
+		{}
+
+		T * allocate(std::size_t n)
+		{
+			return static_cast<T *>(res->allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T * p, std::size_t n)
+		{
+			res->deallocate(p, n * sizeof(T), alignof(T));
+		}
+
+		template <typename U>
+		bool operator==(ArenaAllocator<U> const & a) const
+		{
+			return res == a.res;
+		}
+
+		template <typename U>
+		bool operator!=(ArenaAllocator<U> const & a) const
+		{
+			return res != a.res;
+		}
+	};
+
+	/// memory of a Parser handed out in chunks and released all at once, counting what it takes from the heap
+	class Arena :
+		public std::pmr::memory_resource
+	{
+		class Counter :
+			public std::pmr::memory_resource
+		{
+		public:
+			std::size_t bytes = 0; ///<allocated from the heap
+		protected:
+			void * do_allocate(std::size_t n, std::size_t align) override;
+			void do_deallocate(void * p, std::size_t n, std::size_t align) override;
+			bool do_is_equal(std::pmr::memory_resource const & r) const noexcept override;
+		} counter;
+		std::pmr::monotonic_buffer_resource pool;
+	public:
+		Arena(std::size_t initial); ///<arena starting with a chunk of `initial` bytes
+		std::size_t get_bytes() const; ///<bytes taken from the heap so far
+	protected:
+		void * do_allocate(std::size_t n, std::size_t align) override;
+		void do_deallocate(void * p, std::size_t n, std::size_t align) override;
+		bool do_is_equal(std::pmr::memory_resource const & r) const noexcept override;
+	};
+
+	/// counters of one option, kept while instrumentation is on
+	struct OptionStats {
+		int key;
+		std::string name;
+		unsigned long hits = 0; ///<times the option is processed
+		unsigned long sets = 0; ///<calls of `Value::set`
+		double set_ns = 0; ///<time in `Value::set`
+		unsigned long calls = 0; ///<calls of the callback
+		double call_ns = 0; ///<time in the callback
+	};
+
+	/// instrumentation of a Parser
+	struct Stats {
+		unsigned long parses = 0; ///<calls of `Parser::parse`
+		unsigned long tokens = 0; ///<tokens parsed, those from response files included
+		double parse_ns = 0; ///<time in `Parser::parse`, conversions and callbacks included
+		unsigned long helps = 0; ///<help texts made
+		double help_ns = 0; ///<time making help texts
+		std::size_t arena_bytes = 0; ///<bytes the parser took from the heap for options and values
+		std::deque<OptionStats> options; ///<by option in order added, never moved
+
+		OptionStats const * find(std::string const & name) const; ///<counters of option with long name, `nullptr` if none
+		OptionStats const * find(int key) const; ///<counters of option with key, `nullptr` if none
+		std::string to_json() const; ///<all counters as a JSON object
+	};
+
+	/// make a shared object in `arena`, or on the heap if there is none
+	template <typename T, typename... A>
+	std::shared_ptr<T> make_in(std::shared_ptr<std::pmr::memory_resource> const & arena, A &&... args)
+	{
+		if (! arena) return std::make_shared<T>(std::forward<A>(args)...);
+		return std::allocate_shared<T>(ArenaAllocator<T>(arena), std::forward<A>(args)...);
+	}
+
+	/// kinds of failure in `Parser::try_parse`
+	enum class ParseCode {
+		ok, ///<no failure
+		unknown_option,
+		ambiguous_option, ///<an abbreviation matching several long names
+		missing_value,
+		unwanted_value,
+		bad_value, ///<a value that can not be converted
+		reset, ///<a value set `once` given again
+		callback_failed, ///<a callback returning `false`
+		argument_count, ///<positional arguments of a wrong number
+		bad_input ///<a token source failing, as with an unterminated quote
 	};
 
 	/// signature for callback functions
@@ -41,31 +170,78 @@ namespace arg {
 	/// options to be parsed
 	class Option
 	{
+		// fields used in parsing, kept together in the first cache lines
 		int key;
-		std::string name;
-
-		std::shared_ptr<Value> store_ptr; ///<pointer to storage space
+		unsigned given; ///<serial number of the last parse giving the option, 0 for none
 		bool store_optional; ///<if value string is optional
-		std::string store_str; ///<default value string
-
-		bool * set_bool;
 		bool bool_value;
-		int * set_var; ///<variable to set
-		int set_value; ///<value to set
 		bool set_once; ///<if can only set once
+		int set_value; ///<value to set
 		int set_init; ///<initial value, 
-
+		bool * set_bool;
+		int * set_var; ///<variable to set
 		CallBack * call_func; ///<callback function
 		void * call_data; ///<data to pass to callback function
-
-		std::string help_text;
-		std::string help_var;
-		bool help_default; ///<whether to show default value of store
+		OptionStats * stats; ///<counters, `nullptr` when not instrumented
+		std::shared_ptr<Value> store_ptr; ///<pointer to storage space
+		bool deferred; ///<whether `pending` awaits conversion by `materialize`
+		bool init_taken; ///<whether `store_init` is taken, which is left to the first change of the value or `get_argv`
+		std::string_view pending; ///<value given in lazy mode, viewing into the parsed tokens
+		std::size_t pending_index; ///<position of the token giving `pending`
+		std::string name;
+		friend struct ParseError;
+		ParseCode try_flags(); ///<set the variables of `set`, failing on a re-set
+		ParseCode try_defer(std::string_view str, std::size_t index); ///<as `try_process(str)` but leaving `str` for `materialize`
+		void take_init(); ///<take `store_init` from the value as it is now
+
+		/// fields for help, regeneration and modifiers, kept apart from those for parsing
+		struct Cold {
+			std::string store_str; ///<default value string
+			std::string store_init; ///<value of storage before it is first changed, as a string
+			bool store_known = false; ///<whether `store_init` could be taken
+			bool bool_init = false; ///<value of `* set_bool` when set
+			int var_init = 0; ///<value of `* set_var` when set
+			std::string help_text;
+			std::string help_var;
+			bool help_default = false; ///<whether to show default value of store
+			bool env_bound = false; ///<whether the option takes a value from the environment
+			std::string env_var; ///<environment variable of the option, named after the option if empty
+			unsigned rev = 0; ///<revision, bumped by modifiers to tell when help needs rendering again
+			std::shared_ptr<std::pmr::memory_resource> arena; ///<where values are made, the heap if null
+		};
+		/// the Cold fields of one Option, copied with it
+		class ColdPtr
+		{
+			std::shared_ptr<Cold> p;
+		public:
+			ColdPtr(std::shared_ptr<Cold> c) :
+				p(std::move(c))
+			{}
+			ColdPtr(ColdPtr const & c) :
+				p(make_in<Cold>(c->arena, * c))
+			{}
+			ColdPtr & operator=(ColdPtr const & c)
+			{
+				p = make_in<Cold>(c->arena, * c);
+				return * this;
+			}
+			Cold * operator->() const
+			{
+				return p.get();
+			}
+			Cold & operator*() const
+			{
+				return * p;
+			}
+		};
+		ColdPtr cold;
+		friend class Parser;
 	public:
 		/// command-line option with key and name
 		Option(
 			int key, ///< unique single character key for the option
-			std::string const & name ///<name for the option
+			std::string const & name, ///<name for the option
+			std::shared_ptr<std::pmr::memory_resource> arena = nullptr ///<where the option data and values are made, the heap if null
 		);
 		~Option();
 
@@ -80,20 +256,32 @@ namespace arg {
 		Option & help(std::string const & text, std::string const & var = ""); ///<help text
 		Option & help_word(std::string const & var); ///<help word
 		Option & show_default(bool do_show = true); ///<show default value in help
+		Option & env(std::string const & var = ""); ///<take value from environment variable "var", by default the name with the prefix of the parser in capitals, which an option without a name has to give
 
-		bool take_value();
-		bool need_value();
-		int get_key();
-		std::string const & get_name();
+		bool take_value() const;
+		bool need_value() const;
+		int get_key() const;
+		std::string const & get_name() const;
 
 		enum HelpFormat {
 			HF_REGULAR,
 			HF_NODASH
 		};
 		std::string get_help(HelpFormat format = HF_REGULAR);
+		std::string get_help_head(HelpFormat format = HF_REGULAR); ///<the option column of help
+		std::string get_help_body(); ///<help text with the default value if shown
 
 		void process();
 		void process(std::string const & str);
+		ParseCode try_process(std::exception_ptr * fault = nullptr); ///<as `process()` but returning what failed instead of throwing, the Error of the value going to `* fault`
+		ParseCode try_process(std::string_view str, std::exception_ptr * fault = nullptr); ///<as `process(str)` but returning what failed instead of throwing, the Error of the value going to `* fault`
+		[[noreturn]] void fail(ParseCode code, std::string_view str, std::exception_ptr fault = nullptr); ///<throw the Error for `code` from `try_process(str)`, `fault` if there is one
+		bool is_deferred() const; ///<whether a value given in lazy mode awaits conversion
+		ParseCode try_materialize(std::exception_ptr * fault = nullptr); ///<convert the value left by a lazy parse, if any
+		void materialize(); ///<as `try_materialize` but throwing the Error at the position of the value
+		/// append tokens that give the current value, none if it is still the initial one, throwing
+		/// if the option was given but its value can not be told, as for a callback
+		void add_args(std::vector<std::string> & toks);
 	};
 
 	/// Positional arguments on command line
@@ -102,6 +290,10 @@ namespace arg {
 		std::string name;
 		std::shared_ptr<Value> store_ptr; ///<pointer to storage space
 		std::string help_text;
+		bool many = false; ///<whether all the remaining positional arguments are taken
+		std::shared_ptr<std::pmr::memory_resource> arena; ///<where values are made, the heap if null
+		friend class Parser;
+		friend struct ParseError;
 	public:
 		/// positional argument with name
 		Argument(
@@ -113,8 +305,10 @@ namespace arg {
 		template<typename T> Argument & stow(T & t); ///<stow value to streamable variable
 		Argument & store(std::shared_ptr<Value> ptr = 0); ///<store value to "* ptr", the Value will be released by the Argument
 		Argument & help(std::string const & text); ///<help text
+		Argument & variadic(bool v = true); ///<take one or more positional arguments, each converted in turn, for the last Argument
 
 		std::string const & get_name(); ///<get name of the argument
+		bool is_variadic() const; ///<whether the argument takes one or more positional arguments
 
 		enum HelpFormat {
 			HF_REGULAR,
@@ -122,37 +316,368 @@ namespace arg {
 		};
 		std::string get_help(); ///<get help text
 		void process(std::string const & str); ///<process string data
+		ParseCode try_process(std::string_view str, std::exception_ptr * fault = nullptr); ///<as `process` but returning what failed instead of throwing, the Error of the value going to `* fault`
+	};
+
+	/// prefix tree over long option names
+	class NameTrie
+	{
+		struct Node {
+			int pos = -1; ///<position of the name ending here, -1 if none
+			int count = 0; ///<number of names in the subtree
+			std::vector<std::pair<unsigned char, int>> kids; ///<child nodes sorted by character
+		};
+		std::vector<Node> nodes;
+		int child(int n, unsigned char c) const; ///<child of node `n` by `c`, -1 if none
+		int node(std::string_view prefix) const; ///<node reached by `prefix`, -1 if none
+	public:
+		NameTrie();
+		void clear(); ///<remove all names
+		void insert(std::string_view name, int pos); ///<add a name not yet in the tree
+		int match(std::string_view prefix) const; ///<position of the only name starting with `prefix`, -1 if none, -2 if several
+		void collect(std::string_view prefix, std::vector<int> & pos) const; ///<append positions of names starting with `prefix` in order of name
+	};
+
+	class Parser;
+
+	/// failure of `Parser::try_parse`, with the message made only when asked for
+	struct ParseError {
+		ParseCode code = ParseCode::ok;
+		std::size_t index = 0; ///<position of the token at fault after the program name
+		std::string_view token; ///<long name, short key or positional argument at fault, viewing into the parsed tokens
+		std::string_view value; ///<value at fault, the optional default if none is given
+		char key = 0; ///<short key at fault, 0 if `token` is not one
+		Option * opt = nullptr; ///<option at fault
+		Argument * arg = nullptr; ///<positional argument at fault
+		Parser const * parser = nullptr; ///<parser reporting the failure
+		std::string note; ///<message from the token source for `bad_input`
+		std::exception_ptr fault; ///<Error thrown by the `set` of a value at fault, rethrown by `Parser::raise`, null for the values made by `Value::conv_error` instead
+
+		explicit operator bool() const; ///<whether there is a failure
+		std::string message() const; ///<the message of the failure, as `Parser::parse` would throw but for the wording of value errors
+	};
+
+	/// outcome of one `Parser::scan`, independent of other scans of the same Parser
+	class ParseResult
+	{
+	public:
+		/// an option given on the command line
+		struct Occurrence {
+			Option const * opt; ///<owned by the Parser
+			std::string_view value; ///<value given, or the optional default
+			bool has_value; ///<whether a value was taken
+			std::size_t index; ///<position of the token after the program name
+		};
+	private:
+		Parser const * parser;
+		std::string_view prog_view;
+		std::vector<std::string_view> arg_views;
+		std::vector<Occurrence> occ_list;
+		std::vector<std::shared_ptr<char>> maps; ///<response files viewed by the tokens
+		std::string line_buf; ///<unquoted tokens of a scanned command line
+		friend class Parser;
+	public:
+		ParseResult(Parser const & p);
+
+		std::string_view prog() const; ///<program name, empty if scanned from a Source
+		std::vector<std::string_view> const & args() const; ///<positional arguments
+		std::vector<Occurrence> const & occurrences() const; ///<options in the order given
+		std::size_t count(int key) const; ///<times the option with key is given
+		std::size_t count(std::string_view name) const; ///<times the option with name is given
+		Occurrence const * last(int key) const; ///<last occurrence of option with key, `nullptr` if not given
+		Occurrence const * last(std::string_view name) const; ///<last occurrence of option with name, `nullptr` if not given
+
+		/// converted value of the last occurrence of option `name`, `def` if not given
+		template <typename T> T get(std::string_view name, T const & def = T()) const;
 	};
 
 	/// The command-line parser
 	class Parser
 	{
+		std::shared_ptr<Arena> arena; ///<options and values of the parser, released together
+		std::shared_ptr<Stats> stats; ///<instrumentation, `nullptr` when off, shared by copies as the options are
 		std::string header_text;
 		std::string version_info;
 	protected:
 		std::string prog_name; ///<name to identify the program
 		std::vector<std::shared_ptr<Option>> opt_list;
 		std::vector<std::shared_ptr<Argument>> arg_list;
-		std::vector<std::string> arg_strs;
+		std::vector<std::string_view> arg_toks; ///<positional arguments, viewing into the parsed tokens
+		std::vector<std::size_t> arg_index; ///<token index of each of `arg_toks`, for the ParseError of a positional argument
+		std::vector<std::string> arg_strs; ///<copies of `arg_toks` made on demand by `args()`
+		bool arg_strs_stale = false; ///<`arg_strs` need to be remade from `arg_toks`
+		unsigned parse_serial = 0; ///<number of parses so far, to tell options given in the last one
+		bool rsp_files = false; ///<expand "@file" tokens
+		std::vector<std::shared_ptr<char>> rsp_maps; ///<response files mapped in the last parse, viewed by `arg_toks`
+		std::string line_buf; ///<unquoted tokens of the last command line parsed, viewed by `arg_toks`
+		struct ArgsFrom {
+			char delim; ///<delimiter of the tokens in the files
+		};
+		std::vector<std::shared_ptr<ArgsFrom>> args_from; ///<data for the callbacks of `add_opt_args_from` options, shared by copies as the options are
+		std::string env_prefix; ///<prefix of the variables named after options
+		bool completion = false; ///<answer "__complete" queries, set by `add_opt_completion`
+		void answer_completion(int argc, char * argv[]); ///<print completions and exit if `argv` is a "__complete" query
+		static bool args_from_callback(int key, std::string const & path, void * data); ///<start reading tokens from `path` in the parser taking tokens on this thread
 		struct HelpLine {
 			std::string msg;
-			std::shared_ptr<Option> opt;
-			HelpLine(std::string const & m, std::shared_ptr<Option> o);
+			Option * opt; ///<owned by `opt_list`
+			std::string text; ///<rendered help of `opt`
+			unsigned rev; ///<revision of `opt` when rendered
+			bool fresh; ///<whether `text` has been rendered
+			HelpLine(std::string const & m, Option * o);
 		};
 		std::vector<HelpLine> help_list;
+		int help_width = 0; ///<wrapping width of the rendered help lines
+		void render_help(int width); ///<render help lines of options changed since last time or showing their default
+		std::string get_usage(); ///<usage line of help
+		std::string get_arg_help(); ///<help for positional arguments
+		int key_index[256]; ///<position in `opt_list` by short key, -1 if none
+		std::unordered_map<int, int> wide_key_index; ///<position in `opt_list` by key outside `key_index`
+		struct NameSlot {
+			std::uint32_t hash; ///<low bits of the hash of the name
+			int pos; ///<position in `opt_list`, -1 if the slot is empty
+		};
+		std::vector<NameSlot> name_slots; ///<long names by hash, open-addressed with a power-of-two size, at most half full
+		std::size_t name_count = 0; ///<used slots in `name_slots`
+		int name_find(std::string_view name) const; ///<position in `opt_list` of option with `name`, -1 if none
+		bool name_insert(std::string_view name, int pos); ///<add name of `opt_list[pos]`, false if taken
+		void index_opt(int pos); ///<add `opt_list[pos]` to the index, rejecting duplicates
+		void reindex(); ///<rebuild the index from `opt_list`
+		Option * lookup(int key) const; ///<indexed lookup by key, `nullptr` if not found
+		Option * lookup(std::string_view name) const; ///<indexed lookup by name, `nullptr` if not found
+		bool abbrev = false; ///<accept unique prefixes of long names
+		NameTrie name_trie; ///<positions in `opt_list` by long name, kept when `abbrev` is set
+		bool lazy = false; ///<leave stored values unconverted in parsing
+		std::vector<Option *> pending_opts; ///<options with values left by the last lazy parse, owned by `opt_list`
+		void drop_pending(Option * o = nullptr); ///<forget the value left unconverted in `o`, or in all options if null
+		Option * match(std::string_view name) const; ///<lookup by name or, if `abbrev`, its unique prefix, throws AmbigError
+		Option * match(std::string_view name, bool & ambiguous) const; ///<as `match` but setting `ambiguous` instead of throwing
+		[[noreturn]] void raise(ParseError const & err) const; ///<throw the Error `parse` throws for `err`
+		void start_parse(); ///<forget the results of the last parse
+		Argument * arg_at(std::size_t i) const; ///<Argument for the positional argument at `i`, `nullptr` if none
+		bool arg_count_ok(std::size_t n) const; ///<whether `arg_list` takes `n` positional arguments
+		friend struct ParseError;
+		friend class ParseResult;
+		friend class Batch;
 	public:
+		Parser();
 		~Parser();
 		void add_help(std::string const & msg); ///<add additional help text between option helps
 		Option & add_opt(int key, std::string const & name = "", bool hide = false); ///<add an Option
 		Option & add_opt(std::string const & name, bool hide = false); ///<add an Option without a specified key
 		Option & get_opt(std::string const & name); ///<get an existing Option
 		std::vector<std::string> & args(); ///<get the argument list
-		/// perform command-line parsing
+		std::vector<std::string_view> const & arg_views() const; ///<get the argument list as views into the parsed tokens
+
+		/// a sequence of command-line tokens
+		class Source
+		{
+		public:
+			virtual ~Source();
+			virtual bool next(std::string_view & tok) = 0; ///<get the next token, `false` at the end
+		};
+
+		/// tokens read incrementally from a file descriptor, each ended by a delimiter,
+		/// through two buffers of fixed size, grown only for a token longer than one;
+		/// a token stays valid until the second call of `next` after it
+		class FdSource :
+			public Source
+		{
+			int fd;
+			bool own; ///<whether to close `fd` at destruction
+			char delim; ///<end of each token, `'\n'` with empty lines skipped, or `'\0'`
+			std::vector<char> bufs[2];
+			int cur = 0; ///<buffer being read
+			std::size_t pos = 0; ///<start of the unread data in `bufs[cur]`
+			std::size_t end = 0; ///<end of the data in `bufs[cur]`
+			bool fresh = true; ///<whether no token has been handed out from `bufs[cur]`
+			bool eof = false;
+		public:
+			FdSource(
+				int fd, ///<file descriptor to read
+				char delim = '\n', ///<token delimiter, as `'\0'` for the output of `find -print0`
+				std::size_t size = 65536, ///<size of each buffer
+				bool own = false ///<whether to close `fd` at destruction
+			);
+			~FdSource();
+			bool next(std::string_view & tok) override;
+		};
+	private:
+		std::vector<std::shared_ptr<Source>> fd_srcs; ///<sources opened by `add_opt_args_from` options in the last parse, shared by copies of the Parser
+		std::vector<Source *> fd_stack; ///<sources in `fd_srcs` not yet exhausted, read from the top before the tokens given
+		bool fd_tok = false; ///<whether the last token read came from `fd_stack`, to be copied if kept
+		std::deque<std::string> fd_copies; ///<positional arguments read from `fd_stack` in the last parse, viewed by `arg_toks`
+		/// process options up to the next positional argument, given at `index - 1` in `pos`, false at the end or on a failure put in `err`
+		bool step(Source & src, std::size_t & index, std::string_view & pos, ParseError & err, bool ignore_unknown);
+	public:
+
+		/// parse that hands out the positional arguments one at a time, as they are reached
+		class Stream
+		{
+			Parser * parser;
+			std::unique_ptr<Source> own; ///<source made by the Parser, if any
+			std::unique_ptr<Source> rsp; ///<expansion of response files, if on
+			Source * src; ///<where the tokens come from
+			bool ignore_unknown;
+			bool done = false; ///<whether the tokens are exhausted or have failed
+			std::size_t index = 0; ///<position of the next token after the program name
+			std::size_t count = 0; ///<positional arguments handed out
+			std::string_view tok; ///<the current positional argument
+			Stream(Parser & p, std::unique_ptr<Source> own, Source * src, bool ignore_unknown);
+			friend class Parser;
+		public:
+			/// process options up to the next positional argument, converted by its Argument if any
+			ParseError try_next();
+			bool next(); ///<as `try_next` but throwing as `Parser::parse`, false at the end
+			std::string_view token() const; ///<the current positional argument, viewing into the parsed tokens
+			std::size_t position() const; ///<count of positional arguments handed out, the current one included
+			bool at_end() const; ///<whether all tokens have been processed
+
+			/// input iterator over the positional arguments, throwing as `next`
+			class iterator
+			{
+				Stream * s; ///<`nullptr` at the end
+			public:
+				using iterator_category = std::input_iterator_tag;
+				using value_type = std::string_view;
+				using difference_type = std::ptrdiff_t;
+				using pointer = std::string_view const *;
+				using reference = std::string_view;
+				iterator(Stream * s = nullptr);
+				std::string_view operator * () const;
+				iterator & operator ++ ();
+				bool operator == (iterator const & i) const;
+				bool operator != (iterator const & i) const;
+			};
+			iterator begin(); ///<process up to the first positional argument
+			iterator end();
+		};
+
+		/// start a parse of `argv` handing out positional arguments through the Stream, not keeping them
+		Stream stream(
+			int argc, ///<count of command-line tokens
+			char * argv[], ///<c-string array of command-line tokens
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		);
+		/// start a parse of tokens from a Source, the program name excluded, as `stream(argc, argv)`
+		Stream stream(
+			Source & src, ///<source of the tokens, to outlive the Stream
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		);
+
+		/// perform command-line parsing. A long option takes a value only after '=', "--name" alone being
+		/// processed as given no value: a flag is set, an `optional` value takes its default, others fail
 		void parse(
 			int argc, ///<count of command-line tokens
 			char * argv[], ///<c-string array of command-line tokens
 			bool ignore_unknown = false ///<whether to ignore unknown options
 		);
+		/// perform parsing on caller-owned tokens, which must outlive the use of `arg_views()`
+		void parse(
+			std::vector<std::string_view> const & tokens, ///<command-line tokens, the first being the program name
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		);
+		/// perform parsing on a command line split as by a POSIX shell, which must outlive the use of `arg_views()`
+		void parse(
+			std::string_view line, ///<command line, the first word being the program name
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		);
+		/// perform parsing on tokens from a Source, the program name excluded
+		void parse(
+			Source & src, ///<source of the tokens
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		);
+		/// perform parsing as `parse`, returning the first failure instead of throwing
+		ParseError try_parse(
+			int argc, ///<count of command-line tokens
+			char * argv[], ///<c-string array of command-line tokens
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		);
+		/// perform parsing on caller-owned tokens, returning the first failure
+		ParseError try_parse(
+			std::vector<std::string_view> const & tokens, ///<command-line tokens, the first being the program name
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		);
+		/// perform parsing on tokens from a Source, returning the first failure
+		ParseError try_parse(
+			Source & src, ///<source of the tokens
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		);
+		/// set options from a configuration file, keeping those given on the command line in the last parse
+		void parse_config(
+			std::string const & path, ///<file of "name = value" lines, with "[section]" prefixing "section." to names
+			bool ignore_unknown = false ///<whether to ignore unknown names
+		);
+		/// set options from configuration text
+		void parse_config(
+			std::string_view text, ///<content as for a configuration file
+			std::string const & name, ///<name of the content in error messages
+			bool ignore_unknown = false ///<whether to ignore unknown names
+		);
+		/// set options bound by `Option::env` from the environment in one pass, keeping those given
+		/// on the command line in the last parse and counting those set as given, so that a later
+		/// `parse_config` keeps them too
+		void parse_env(
+			char const * const * envp = nullptr ///<"NAME=value" strings ending with a null, `environ` if null
+		);
+		void set_env_prefix(std::string const & prefix); ///<prefix of the variables named after options, as "PROG_" for "PROG_LOG_LEVEL" from "log-level"
+		/// parse into a result without touching the options, safe to call from many threads at once
+		ParseResult scan(
+			int argc, ///<count of command-line tokens
+			char const * const argv[], ///<c-string array of command-line tokens
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		) const;
+		/// scan caller-owned tokens, which must outlive the result
+		ParseResult scan(
+			std::vector<std::string_view> const & tokens, ///<command-line tokens, the first being the program name
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		) const;
+		/// scan a command line split as by a POSIX shell, which must outlive the result
+		ParseResult scan(
+			std::string_view line, ///<command line, the first word being the program name
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		) const;
+		/// scan a command line into an existing result, reusing its storage
+		void scan(
+			std::string_view line, ///<command line, the first word being the program name
+			ParseResult & res, ///<result to fill
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		) const;
+		/// scan tokens from a Source, the program name excluded
+		void scan(
+			Source & src, ///<source of the tokens
+			ParseResult & res, ///<result to fill
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		) const;
+		/// as `scan` but returning the failure instead of throwing an Error
+		ParseError try_scan(
+			std::string_view line, ///<command line, the first word being the program name
+			ParseResult & res, ///<result to fill
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		) const;
+		/// as `scan` from a Source but returning the failure instead of throwing an Error
+		ParseError try_scan(
+			Source & src, ///<source of the tokens
+			ParseResult & res, ///<result to fill
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		) const;
+		/// tokens giving the current values of options that differ from their initial ones
+		std::vector<std::string> get_argv() const;
+		/// append the completions of the last of `words`, the tokens after the program name up
+		/// to the cursor, none where the shell is to complete file names
+		void complete(std::vector<std::string_view> const & words, std::vector<std::string> & out) const;
+		std::string get_completion_script(std::string const & shell) const; ///<script for "bash" or "zsh" completing the program through "__complete"
+		void set_stats(bool enable = true); ///<count and time parsing, starting from zero
+		Stats const * get_stats(); ///<counters since `set_stats`, `nullptr` when off
+		void set_abbreviations(bool enable = true); ///<accept unique prefixes of long option names, as "--verb" for "--verbose"
+		void set_response_files(bool enable = true); ///<expand "@file" tokens into the shell-quoted tokens in "file"
+		/// only check the syntax when parsing, leaving the values of stored options to `materialize`,
+		/// where only the last value given to each option is converted; the values view into the
+		/// parsed tokens and are dropped by the next parse, while options with callbacks and
+		/// positional arguments are processed at once
+		void set_lazy(bool enable = true);
+		void materialize(); ///<convert the values left by a lazy parse, throwing the first failure
+		ParseError try_materialize(); ///<as `materialize` but returning the first failure instead of throwing
 		void set_header(std::string const & text); ///<set the header in help
 		std::string const & get_header() const; ///<get the header text of help
 
@@ -166,9 +691,20 @@ namespace arg {
 		void remove_all(); // remove all options
 
 		std::string get_help();
+		/// write help to a file descriptor without building it in one string
+		void write_help(
+			int fd, ///<file descriptor to write to
+			int width = -1 ///<column to wrap help text at, 0 for no wrapping, -1 for the terminal width if `fd` is a terminal
+		);
 		// default options
 		Option & add_opt_help();
 		Option & add_opt_version(std::string const & version);
+		/// option printing a completion script for a shell, also answering the "__complete WORD..."
+		/// queries of the script in `parse` before any option is processed
+		Option & add_opt_completion();
+		/// option to read further tokens from a file, or standard input for "-", one per `delim`,
+		/// handled as they are read so that a Stream takes them in constant memory
+		Option & add_opt_args_from(char delim = '\n', std::string const & name = "args-from");
 
 		// positional arguments
 		Argument & add_arg(std::string const & name);
@@ -180,11 +716,15 @@ namespace arg {
 		public Parser
 	{
 		char sep;
+		char assign;
+		std::string value_buf; ///<value of the pair being processed
 	public:
 		SubParser();
 		void set(std::string const & str); // parse the str
+		std::string to_str() const; // the sub-options that differ from their initial values, as `set` takes them
 		std::string get_help();
 		void set_sep(char s); // set the separator to s from ','
+		void set_assign(char a); // set the character between name and value to a from '='
 		// default options
 		Option & add_opt_help();
 	};
@@ -199,6 +739,7 @@ namespace arg {
 		Error();
 		Error(std::string const & msg);
 		std::string get_msg();
+		Error & at(std::string const & where); ///<prefix the message with where the error is
 	};
 
 	class OptError : // option processing error
@@ -225,6 +766,15 @@ namespace arg {
 		UnknError(std::string const & opt);
 	};
 
+	class AmbigError : // ambiguous abbreviation of options
+		public Error
+	{
+		std::vector<std::string> names;
+	public:
+		AmbigError(std::string const & opt, std::vector<std::string> const & candidates);
+		std::vector<std::string> const & get_candidates() const; ///<names the abbreviation could be
+	};
+
 	class MissingError : // missing argument
 		public Error
 	{
@@ -233,7 +783,68 @@ namespace arg {
 	};
 	// Templates:
 
-	// value types that have << and >> defined for istream/ostream
+	/// arithmetic types converted with `std::from_chars` and `std::to_chars` instead of streams
+	template <typename T>
+	struct is_charconv :
+		std::integral_constant<bool,
+			std::is_floating_point<T>::value || (
+				std::is_integral<T>::value &&
+				! std::is_same<T, bool>::value &&
+				! std::is_same<T, char>::value &&
+				! std::is_same<T, signed char>::value &&
+				! std::is_same<T, unsigned char>::value &&
+				! std::is_same<T, wchar_t>::value &&
+				! std::is_same<T, char16_t>::value &&
+				! std::is_same<T, char32_t>::value
+			)
+		>
+	{};
+
+	/// convert `str` to `v`, returning `false` unless all of `str` is taken
+	template <typename T>
+	bool parse_value(std::string_view str, T & v)
+	{
+		if constexpr (is_charconv<T>::value) {
+			char const * b = str.data();
+			char const * e = b + str.size();
+			while (b != e && isspace((unsigned char)* b)) b ++; // as skipped by `>>`
+			if (b == e) { // nothing to extract, as `>>` leaves it
+				v = T();
+				return true;
+			}
+			if (* b == '+' && e - b > 1 && b[1] != '-') b ++; // `from_chars` takes no plus sign
+			auto r = std::from_chars(b, e, v);
+			return r.ec == std::errc() && r.ptr == e;
+		}
+		else if constexpr (std::is_same<T, std::string>::value) { // whole string, blanks included
+			v = str;
+			return true;
+		}
+		else {
+			std::istringstream s{std::string(str)};
+			s >> v;
+			return ! s.bad() && s.eof();
+		}
+	}
+
+	/// convert `v` to a string, the shortest one that converts back exactly for arithmetic types
+	template <typename T>
+	std::string format_value(T const & v)
+	{
+		if constexpr (is_charconv<T>::value) {
+			char buf[64];
+			auto r = std::to_chars(buf, buf + sizeof(buf), v);
+			return std::string(buf, r.ptr);
+		}
+		else {
+			std::ostringstream s;
+			s << v;
+			return s.str();
+		}
+	}
+
+	// value types that have << and >> defined for istream/ostream, arithmetic types converted
+	// with charconv and std::string taking the whole value, blanks included, not a word of it
 	template <typename T>
 	class StreamableValue :
 		public Value
@@ -247,18 +858,20 @@ namespace arg {
 
 		void set(std::string const & str)
 		{
-			std::istringstream s(str);
+			if (! try_set(str)) throw ConvError(str, typeid(T).name());
+		}
+
+		bool try_set(std::string_view str, std::exception_ptr * = nullptr)
+		{
 			T tmp;
-			s >> tmp;
-			if (s.bad() || ! s.eof()) throw ConvError(str, typeid(T).name());
+			if (! parse_value(str, tmp)) return false;
 			ptr = tmp;
+			return true;
 		}
 
 		std::string to_str() const
 		{
-			std::ostringstream s;
-			s << ptr;
-			return s.str();
+			return format_value(ptr);
 		}
 
 		std::string get_type() const
@@ -270,12 +883,22 @@ namespace arg {
 	template<typename T>
 	Option & Option::stow(T & t)
 	{
-		return store(std::make_shared<StreamableValue<T>>(t));
+		return store(make_in<StreamableValue<T>>(cold->arena, t));
 	}
 
 	template<typename T>
 	Argument & Argument::stow(T & t)
 	{
-		return store(std::make_shared<StreamableValue<T>>(t));
+		return store(make_in<StreamableValue<T>>(arena, t));
+	}
+
+	template <typename T>
+	T ParseResult::get(std::string_view name, T const & def) const
+	{
+		auto o = last(name);
+		if (! o || ! o->has_value) return def;
+		T t;
+		if (! parse_value(o->value, t)) throw ConvError(std::string(o->value), typeid(T).name());
+		return t;
 	}
 }
@@ -0,0 +1,694 @@
+// Micro-benchmarks for the arg library
+//
+// Each benchmark reports time, heap allocations and allocated bytes per
+// operation, the median of several runs, and hardware cache misses per
+// operation where the system can count them.  With --json, the results
+// are written as a JSON document that can be compared between releases.
+#include <arg.hh>
+#include <val.hh>
+#include <batch.hh>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+using namespace std;
+
+namespace {
+	atomic<size_t> alloc_count(0);
+	atomic<size_t> alloc_bytes(0);
+}
+
+// count every allocation of the program
+#if defined(__GNUC__) && ! defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // the replacements pair malloc and free
+#endif
+void * operator new(size_t n)
+{
+	alloc_count.fetch_add(1, memory_order_relaxed);
+	alloc_bytes.fetch_add(n, memory_order_relaxed);
+	if (void * p = malloc(n ? n : 1)) return p;
+	throw bad_alloc();
+}
+
+void * operator new[](size_t n)
+{
+	return operator new(n);
+}
+
+void operator delete(void * p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void * p, size_t) noexcept
+{
+	free(p);
+}
+
+namespace {
+	typedef chrono::steady_clock Clock;
+	volatile size_t sink; // keeps results from being optimized away
+
+	struct Result {
+		string name;
+		double ns; // per op
+		double allocs; // per op
+		double bytes; // per op
+		double misses; // cache misses per op, negative if not counted
+		double items; // processed per op, for throughput
+	};
+
+	struct Bench {
+		string name;
+		function<void()> op; // one operation
+		double items;
+	};
+
+	double min_time = 0.2; // seconds per run
+	int const runs = 5;
+
+	// counter of hardware cache misses in this process, -1 if there is none
+	int open_misses()
+	{
+#ifdef __linux__
+		perf_event_attr a = {};
+		a.type = PERF_TYPE_HARDWARE;
+		a.size = sizeof(a);
+		a.config = PERF_COUNT_HW_CACHE_MISSES;
+		a.inherit = 1; // threads started by the benchmarks
+		a.exclude_kernel = 1;
+		a.exclude_hv = 1;
+		return syscall(SYS_perf_event_open, & a, 0, -1, -1, 0);
+#else
+		return -1; // reported as "n/a"
+#endif
+	}
+
+	int const miss_fd = open_misses();
+
+	// cache misses counted so far, 0 without a counter
+	double read_misses()
+	{
+		uint64_t n = 0;
+		if (miss_fd < 0 || read(miss_fd, & n, sizeof(n)) != sizeof(n)) return 0;
+		return n;
+	}
+
+	// median over runs of `b.op` repeated for at least `min_time`
+	Result measure(Bench const & b)
+	{
+		vector<double> ns;
+		vector<double> allocs;
+		vector<double> bytes;
+		vector<double> misses;
+		b.op(); // warm up
+		for (int r = 0; r < runs; r ++) {
+			size_t n = 0;
+			size_t c0 = alloc_count;
+			size_t b0 = alloc_bytes;
+			double m0 = read_misses();
+			auto t0 = Clock::now();
+			auto t1 = t0;
+			do {
+				b.op();
+				n ++;
+				t1 = Clock::now();
+			} while (chrono::duration<double>(t1 - t0).count() < min_time);
+			ns.push_back(chrono::duration<double, nano>(t1 - t0).count() / n);
+			allocs.push_back(double(alloc_count - c0) / n);
+			bytes.push_back(double(alloc_bytes - b0) / n);
+			misses.push_back((read_misses() - m0) / n);
+		}
+		for (auto v: {& ns, & allocs, & bytes, & misses}) sort(v->begin(), v->end());
+		return Result{b.name, ns[runs / 2], allocs[runs / 2], bytes[runs / 2], miss_fd < 0 ? -1 : misses[runs / 2], b.items};
+	}
+
+	// argv-style array over `tokens`
+	vector<char *> make_argv(vector<string> & tokens)
+	{
+		vector<char *> argv;
+		for (auto & t: tokens) argv.push_back(& t[0]);
+		return argv;
+	}
+
+	// short key for the `i`-th option, 0 if none
+	int key_of(int i)
+	{
+		return i < 52 ? (i < 26 ? 'a' + i : 'A' + i - 26) : 0;
+	}
+
+	// a parser with `n` options, all taking values
+	void fill(arg::Parser & p, int n, vector<int> & vars)
+	{
+		vars.assign(n, 0);
+		for (int i = 0; i < n; i ++) {
+			p.add_opt(key_of(i), "option-" + to_string(i)).stow(vars[i])
+				.help("set option " + to_string(i), "INT");
+		}
+	}
+
+	// the stream conversion used before `parse_value`/`format_value`
+	template <typename T>
+	class StreamValue :
+		public arg::Value
+	{
+		T & ptr;
+	public:
+		StreamValue(T & t) :
+			ptr(t)
+		{}
+
+		void set(string const & str) override
+		{
+			istringstream s(str);
+			T tmp;
+			s >> tmp;
+			if (s.bad() || ! s.eof()) throw arg::ConvError(str, typeid(T).name());
+			ptr = tmp;
+		}
+
+		string to_str() const override
+		{
+			ostringstream s;
+			s << ptr;
+			return s.str();
+		}
+	};
+
+	// state of a parsing benchmark, built before timing
+	struct Fixture {
+		vector<int> vars;
+		array<bool, 52> flags;
+		vector<string> tokens;
+		vector<char *> argv;
+		arg::Parser parser;
+	};
+
+	void add_parse(vector<Bench> & list, string const & name, shared_ptr<Fixture> f)
+	{
+		f->argv = make_argv(f->tokens);
+		list.push_back(Bench{name, [f](){
+			f->parser.parse(f->argv.size(), f->argv.data());
+		}, double(f->tokens.size() - 1)});
+	}
+
+	// a variable with both kinds of conversion
+	template <typename T>
+	struct Conv {
+		T v;
+		StreamValue<T> sv{v};
+		arg::StreamableValue<T> cv{v};
+	};
+
+	template <typename T>
+	void add_conv(vector<Bench> & list, string const & type, vector<string> const & strs)
+	{
+		auto c = make_shared<Conv<T>>();
+		double n = strs.size();
+		list.push_back(Bench{"conv/" + type + "/stream/set", [=](){
+			for (auto & s: strs) c->sv.set(s);
+		}, n});
+		list.push_back(Bench{"conv/" + type + "/charconv/set", [=](){
+			for (auto & s: strs) c->cv.set(s);
+		}, n});
+		list.push_back(Bench{"conv/" + type + "/stream/to_str", [=](){
+			for (size_t i = 0; i < strs.size(); i ++) sink = c->sv.to_str().size();
+		}, n});
+		list.push_back(Bench{"conv/" + type + "/charconv/to_str", [=](){
+			for (size_t i = 0; i < strs.size(); i ++) sink = c->cv.to_str().size();
+		}, n});
+	}
+
+	// a list of `count` fields made by `field`, built in the warm-up run so that only the lists run take the memory
+	template <typename T>
+	void add_list(vector<Bench> & list, string const & type, size_t count, function<string(size_t)> field)
+	{
+		auto v = make_shared<vector<T>>();
+		auto lv = make_shared<arg::ListValue<T>>(* v);
+		auto str = make_shared<string>();
+		list.push_back(Bench{"list/" + type + "/" + to_string(count), [=](){
+			if (str->empty()) {
+				for (size_t i = 0; i < count; i ++) {
+					if (i) * str += ',';
+					* str += field(i);
+				}
+			}
+			lv->set(* str);
+			sink = v->size();
+		}, double(count)});
+	}
+
+	vector<Bench> make_benches()
+	{
+		vector<Bench> list;
+
+		// parser construction
+		for (int n: {10, 100, 1000, 10000}) {
+			list.push_back(Bench{"construct/" + to_string(n), [n](){
+				arg::Parser p;
+				vector<int> vars;
+				fill(p, n, vars);
+			}, double(n)});
+		}
+
+		// long options spread over the whole option set
+		for (int n: {10, 100, 1000, 5000, 10000}) {
+			auto f = make_shared<Fixture>();
+			fill(f->parser, n, f->vars);
+			f->tokens.push_back("bench");
+			for (int i = 0; i < 100; i ++) f->tokens.push_back("--option-" + to_string(i * 7919 % n) + "=" + to_string(i));
+			add_parse(list, "parse/long/" + to_string(n), f);
+		}
+
+		// long options with instrumentation on
+		{
+			auto f = make_shared<Fixture>();
+			fill(f->parser, 100, f->vars);
+			f->parser.set_stats();
+			f->tokens.push_back("bench");
+			for (int i = 0; i < 100; i ++) f->tokens.push_back("--option-" + to_string(i * 7919 % 100) + "=" + to_string(i));
+			add_parse(list, "parse/stats/100", f);
+		}
+
+		// long options abbreviated to unique prefixes
+		for (int n: {100, 10000}) {
+			auto f = make_shared<Fixture>();
+			f->vars.assign(n, 0);
+			for (int i = 0; i < n; i ++) f->parser.add_opt("option-" + to_string(i) + "-value").stow(f->vars[i]);
+			f->parser.set_abbreviations();
+			f->tokens.push_back("bench");
+			for (int i = 0; i < 100; i ++) f->tokens.push_back("--option-" + to_string(i * 7919 % n) + "-v=" + to_string(i));
+			add_parse(list, "parse/abbrev/" + to_string(n), f);
+		}
+
+		// a list option given repeatedly, converted at each occurrence or only the last
+		for (bool lazy: {false, true}) {
+			auto f = make_shared<Fixture>();
+			auto v = make_shared<vector<int>>();
+			f->parser.add_opt("list").store(make_shared<arg::ListValue<int>>(* v));
+			f->parser.set_lazy(lazy);
+			f->tokens.push_back("bench");
+			string l;
+			for (int i = 0; i < 100; i ++) l += (i ? "," : "") + to_string(i * 7919);
+			for (int i = 0; i < 100; i ++) f->tokens.push_back("--list=" + l);
+			f->argv = make_argv(f->tokens);
+			list.push_back(Bench{string("parse/") + (lazy ? "lazy" : "eager") + "/list/100", [f, v](){
+				f->parser.parse(f->argv.size(), f->argv.data());
+				f->parser.materialize();
+				sink = v->size();
+			}, 100});
+		}
+
+		// many positional arguments into a variadic Argument, kept by parse or handed out by a stream
+		{
+			auto f = make_shared<Fixture>();
+			auto file = make_shared<string>();
+			f->parser.add_arg("FILE").stow(* file).variadic();
+			f->tokens.push_back("bench");
+			for (int i = 0; i < 100000; i ++) f->tokens.push_back("/data/run-" + to_string(i) + ".dat");
+			f->argv = make_argv(f->tokens);
+			list.push_back(Bench{"args/parse/100000", [f](){
+				f->parser.parse(f->argv.size(), f->argv.data());
+				sink = f->parser.args().size();
+			}, 100000});
+			list.push_back(Bench{"args/stream/100000", [f, file](){
+				for (auto t: f->parser.stream(f->argv.size(), f->argv.data())) sink = t.size();
+			}, 100000});
+		}
+
+		// the same arguments read from a file by "--args-from"
+		{
+			char path[] = "/tmp/arg_bench.XXXXXX";
+			int fd = mkstemp(path);
+			if (fd >= 0) {
+				string data;
+				for (int i = 0; i < 100000; i ++) data += "/data/run-" + to_string(i) + ".dat\n";
+				bool ok = write(fd, data.data(), data.size()) == ssize_t(data.size());
+				close(fd);
+				auto f = make_shared<Fixture>();
+				auto file = make_shared<string>();
+				f->parser.add_arg("FILE").stow(* file).variadic();
+				f->parser.add_opt_args_from();
+				f->tokens = {"bench", string("--args-from=") + path};
+				f->argv = make_argv(f->tokens);
+				shared_ptr<string> tmp(new string(path), [](string * p){ // removed with the benchmark
+					unlink(p->c_str());
+					delete p;
+				});
+				if (ok) list.push_back(Bench{"args/fd/100000", [f, file, tmp](){
+					for (auto t: f->parser.stream(f->argv.size(), f->argv.data())) sink = t.size();
+				}, 100000});
+			}
+		}
+
+		// completion queries for long names and enumerated values
+		for (int n: {100, 10000}) {
+			auto f = make_shared<Fixture>();
+			fill(f->parser, n, f->vars);
+			auto c = make_shared<int>();
+			auto sv = make_shared<arg::SetValue>(* c);
+			for (int i = 0; i < n; i ++) sv->add("value-" + to_string(i));
+			f->parser.add_opt("set").store(sv);
+			list.push_back(Bench{"complete/long/" + to_string(n), [f](){
+				vector<string> out;
+				f->parser.complete({"--option-12"}, out);
+				sink = out.size();
+			}, 1});
+			list.push_back(Bench{"complete/value/" + to_string(n), [f](){
+				vector<string> out;
+				f->parser.complete({"--set=value-12"}, out);
+				sink = out.size();
+			}, 1});
+		}
+
+		// options bound to an environment of 200 variables, a quarter of them set there,
+		// looked up one by one as with getenv or taken in one scan
+		for (int n: {100, 1000}) {
+			auto f = make_shared<Fixture>();
+			fill(f->parser, n, f->vars);
+			f->parser.set_env_prefix("BENCH_");
+			for (int i = 0; i < n; i ++) f->parser.get_opt("option-" + to_string(i)).env();
+			for (int i = 0; i < 200; i ++) {
+				f->tokens.push_back(i % 4 ? "OTHER_" + to_string(i) + "=x" : "BENCH_OPTION_" + to_string(i * 7919 % n) + "=" + to_string(i));
+			}
+			f->argv = make_argv(f->tokens);
+			f->argv.push_back(nullptr);
+			list.push_back(Bench{"env/getenv/" + to_string(n), [f, n](){
+				for (int i = 0; i < n; i ++) {
+					string v = "BENCH_OPTION_" + to_string(i) + "=";
+					for (char * const * e = f->argv.data(); * e; e ++) {
+						if (! strncmp(* e, v.c_str(), v.size())) {
+							f->parser.get_opt("option-" + to_string(i)).process(* e + v.size());
+							break;
+						}
+					}
+				}
+			}, double(n)});
+			list.push_back(Bench{"env/scan/" + to_string(n), [f](){
+				f->parser.parse(1, f->argv.data()); // nothing given on the command line
+				f->parser.parse_env(f->argv.data());
+			}, double(n)});
+		}
+
+		// command lines failing on an unknown option at the end, thrown or returned
+		{
+			auto f = make_shared<Fixture>();
+			fill(f->parser, 100, f->vars);
+			f->tokens.push_back("bench");
+			for (int i = 0; i < 10; i ++) f->tokens.push_back("--option-" + to_string(i * 37 % 100) + "=" + to_string(i));
+			f->tokens.push_back("--no-such-option");
+			f->argv = make_argv(f->tokens);
+			list.push_back(Bench{"parse/errors/throw/100", [f](){
+				for (int i = 0; i < 100; i ++) {
+					try {
+						f->parser.parse(f->argv.size(), f->argv.data());
+					}
+					catch (arg::Error &) {
+						sink ++;
+					}
+				}
+			}, 100});
+			list.push_back(Bench{"parse/errors/return/100", [f](){
+				for (int i = 0; i < 100; i ++) {
+					if (f->parser.try_parse(f->argv.size(), f->argv.data())) sink ++;
+				}
+			}, 100});
+		}
+
+		// a command line split by the parser, every fourth value quoted
+		{
+			auto f = make_shared<Fixture>();
+			fill(f->parser, 100, f->vars);
+			auto line = make_shared<string>("bench");
+			for (int i = 0; i < 100; i ++) {
+				* line += " --option-" + to_string(i * 37 % 100) + "=";
+				* line += i % 4 ? to_string(i) : "'" + to_string(i) + "'";
+			}
+			list.push_back(Bench{"parse/line/100", [f, line](){
+				f->parser.parse(string_view(* line));
+			}, 100});
+		}
+
+		// short options, with values attached or following
+		{
+			auto f = make_shared<Fixture>();
+			fill(f->parser, 100, f->vars);
+			f->tokens.push_back("bench");
+			for (int i = 0; i < 100; i ++) {
+				if (i % 2) f->tokens.push_back(string("-") + char(key_of(i % 52)) + to_string(i));
+				else {
+					f->tokens.push_back(string("-") + char(key_of(i % 52)));
+					f->tokens.push_back(to_string(i));
+				}
+			}
+			add_parse(list, "parse/short/100", f);
+		}
+
+		// clusters of short flags
+		{
+			auto f = make_shared<Fixture>();
+			for (int i = 0; i < 52; i ++) f->parser.add_opt(key_of(i)).set(f->flags[i]);
+			f->tokens.push_back("bench");
+			for (int i = 0; i < 100; i ++) {
+				string t = "-";
+				for (int j = 0; j < 8; j ++) t += char(key_of((i * 8 + j) % 52));
+				f->tokens.push_back(t);
+			}
+			add_parse(list, "parse/cluster/100x8", f);
+		}
+
+		// one parser shared by threads scanning at once
+		{
+			auto f = make_shared<Fixture>();
+			fill(f->parser, 100, f->vars);
+			f->tokens.push_back("bench");
+			for (int i = 0; i < 100; i ++) f->tokens.push_back("--option-" + to_string(i * 37 % 100) + "=" + to_string(i));
+			f->argv = make_argv(f->tokens);
+			int const scans = 2000;
+			unsigned cores = max(thread::hardware_concurrency(), 1u);
+			vector<unsigned> counts; // powers of two, then all cores
+			for (unsigned t = 1; t < cores; t *= 2) counts.push_back(t);
+			counts.push_back(cores);
+			for (unsigned t: counts) {
+				list.push_back(Bench{"scan/threads/" + to_string(t), [f, t](){
+					vector<thread> pool;
+					for (unsigned i = 0; i < t; i ++) pool.emplace_back([&f, t, i](){
+						size_t n = 0;
+						for (int j = i; j < scans; j += t) n += f->parser.scan(f->argv.size(), f->argv.data()).occurrences().size();
+						sink = n;
+					});
+					for (auto & th: pool) th.join();
+				}, double(scans)});
+			}
+		}
+
+		// a batch of command lines into columns, by thread count
+		{
+			auto f = make_shared<Fixture>();
+			fill(f->parser, 100, f->vars);
+			auto text = make_shared<string>();
+			int const lines = 100000;
+			for (int i = 0; i < lines; i ++) {
+				* text += "job";
+				for (int j = 0; j < 8; j ++) * text += " --option-" + to_string((i + j * 13) % 100) + "=" + to_string(i);
+				* text += '\n';
+			}
+			unsigned cores = max(thread::hardware_concurrency(), 1u);
+			vector<unsigned> counts; // powers of two, then all cores
+			for (unsigned t = 1; t < cores; t *= 2) counts.push_back(t);
+			counts.push_back(cores);
+			for (unsigned t: counts) {
+				auto b = make_shared<arg::Batch>(f->parser);
+				for (int i = 0; i < 10; i ++) b->column<int>("option-" + to_string(i));
+				list.push_back(Bench{"batch/threads/" + to_string(t), [f, text, b, t](){
+					b->parse(* text, t);
+					sink = b->size();
+				}, double(lines)});
+			}
+		}
+
+		// regenerating tokens of changed options
+		for (int n: {100, 10000}) {
+			auto f = make_shared<Fixture>();
+			fill(f->parser, n, f->vars);
+			for (int i = 0; i < n; i += 2) f->vars[i] = i + 1;
+			list.push_back(Bench{"argv/" + to_string(n), [f](){
+				sink = f->parser.get_argv().size();
+			}, double(n)});
+		}
+
+		// SubParser with many pairs
+		for (int n: {1000, 10000}) {
+			auto sp = make_shared<arg::SubParser>();
+			auto vars = make_shared<vector<int>>(100);
+			for (int i = 0; i < 100; i ++) sp->add_opt("param" + to_string(i)).stow((* vars)[i]);
+			string str;
+			for (int i = 0; i < n; i ++) {
+				if (i) str += ',';
+				str += "param" + to_string(i * 37 % 100) + "=" + to_string(i);
+			}
+			list.push_back(Bench{"subparser/pairs/" + to_string(n), [=](){
+				sp->set(str);
+				sink = vars->size();
+			}, double(n)});
+		}
+
+		// value conversion, the old stream path against charconv
+		vector<string> ints;
+		vector<string> reals;
+		for (int i = 0; i < 1000; i ++) {
+			ints.push_back(to_string(i * 1000003 - 500000000));
+			reals.push_back(to_string(i * 0.37 - 100) + "e" + to_string(i % 20 - 10));
+		}
+		add_conv<int>(list, "int", ints);
+		add_conv<double>(list, "double", reals);
+
+		// large lists
+		size_t const count = 10000000;
+		add_list<int>(list, "int", count, [](size_t i){
+			return to_string(i % 100000);
+		});
+		add_list<double>(list, "double", count, [reals](size_t i){
+			return reals[i % reals.size()];
+		});
+
+		// enumerations
+		for (int n: {10, 1000, 10000}) {
+			auto iv = make_shared<int>();
+			auto sv = make_shared<string>();
+			auto set = make_shared<arg::SetValue>(* iv);
+			auto term = make_shared<arg::TermValue>(* sv);
+			auto names = make_shared<vector<string>>();
+			for (int i = 0; i < n; i ++) {
+				names->push_back("element-" + to_string(i));
+				set->add(names->back());
+				term->add(names->back());
+			}
+			list.push_back(Bench{"setvalue/add/" + to_string(n), [=](){
+				int v;
+				arg::SetValue s(v);
+				for (auto & name: * names) s.add(name);
+			}, double(n)});
+			list.push_back(Bench{"termvalue/add/" + to_string(n), [=](){
+				string v;
+				arg::TermValue t(v);
+				for (auto & name: * names) t.add(name);
+			}, double(n)});
+			list.push_back(Bench{"setvalue/set/" + to_string(n), [=](){
+				for (auto & s: * names) set->set(s);
+				sink = * iv;
+			}, double(n)});
+			list.push_back(Bench{"setvalue/to_str/" + to_string(n), [=](){
+				for (auto & s: * names) {
+					set->set(s);
+					sink = set->to_str().size() + * iv;
+				}
+			}, double(n)});
+			list.push_back(Bench{"termvalue/set/" + to_string(n), [=](){
+				for (auto & s: * names) term->set(s);
+				sink = sv->size();
+			}, double(n)});
+		}
+
+		// help rendering
+		for (int n: {100, 10000}) {
+			auto f = make_shared<Fixture>();
+			fill(f->parser, n, f->vars);
+			list.push_back(Bench{"help/" + to_string(n), [f](){
+				sink = f->parser.get_help().size();
+			}, double(n)});
+			int fd = open("/dev/null", O_WRONLY);
+			if (fd >= 0) list.push_back(Bench{"help/write/" + to_string(n), [f, fd](){
+				f->parser.write_help(fd, 80);
+			}, double(n)});
+		}
+
+		return list;
+	}
+
+	void print_table(vector<Result> const & res)
+	{
+		printf("%-32s %12s %10s %12s %12s %12s\n", "benchmark", "ns/op", "allocs/op", "bytes/op", "items/s", "misses/item");
+		for (auto & r: res) {
+			printf("%-32s %12.1f %10.1f %12.1f %12.4g", r.name.c_str(), r.ns, r.allocs, r.bytes, r.items * 1e9 / r.ns);
+			if (r.misses < 0) printf(" %12s\n", "n/a");
+			else printf(" %12.3f\n", r.misses / r.items);
+		}
+	}
+
+	void print_json(vector<Result> const & res)
+	{
+		printf("{\n  \"benchmarks\": [\n");
+		for (size_t i = 0; i < res.size(); i ++) {
+			auto & r = res[i];
+			printf("    {\"name\": \"%s\", \"ns_per_op\": %.1f, \"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f, ",
+				r.name.c_str(), r.ns, r.allocs, r.bytes);
+			if (r.misses < 0) printf("\"misses_per_op\": null, ");
+			else printf("\"misses_per_op\": %.1f, ", r.misses);
+			printf("\"items_per_op\": %.0f}%s\n", r.items, i + 1 < res.size() ? "," : "");
+		}
+		printf("  ]\n}\n");
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	arg::Parser p;
+	p.set_header("arg micro-benchmarks");
+	string filter;
+	bool json = false;
+	bool list_only = false;
+	p.add_opt('f', "filter").stow(filter)
+		.help("run only benchmarks with STR in their names", "STR");
+	p.add_opt('t', "time").stow(min_time)
+		.help("minimum time of each run in seconds", "SEC")
+		.show_default();
+	p.add_opt('j', "json").set(json)
+		.help("write results as JSON");
+	p.add_opt('l', "list").set(list_only)
+		.help("list benchmark names and exit");
+	p.add_opt_help();
+	try {
+		p.parse(argc, argv);
+	}
+	catch (arg::Error & e) {
+		fprintf(stderr, "Error parsing command line: %s\n", e.get_msg().c_str());
+		return 1;
+	}
+	vector<Result> res;
+	for (auto & b: make_benches()) {
+		if (b.name.find(filter) == string::npos) continue;
+		if (list_only) printf("%s\n", b.name.c_str());
+		else res.push_back(measure(b));
+	}
+	if (list_only) return 0;
+	if (json) print_json(res);
+	else print_table(res);
+	return 0;
+}
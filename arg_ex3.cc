@@ -0,0 +1,36 @@
+#include <schema.hh>
+#include <iostream>
+
+// options fixed at compile time: no allocation is needed to set them up
+constexpr arg::Schema schema{{
+	{'n', "number", "INT", "set number of nodes to INT"},
+	{'i', "input", "FILE", "read data from FILE"},
+	{'v', "verbose", "", "print more messages"},
+	{'h', "help", "", "display this help list and exit"},
+}};
+
+int main(int argc, char ** argv)
+{
+	int n = 10;
+	std::string f;
+	bool verbose = false;
+	bool help = false;
+	auto p = schema.bind(n, f, verbose, help);
+	try {
+		p.parse(argc, argv);
+	}
+	catch (arg::Error & e) {
+		std::cout << "Error parsing command line: " << e.get_msg() << '\n';
+		return 1;
+	}
+	if (help) {
+		std::cout << " Valid options are:\n\n";
+		schema.write_help(std::cout);
+		return 0;
+	}
+	std::cout << "number = " << n << '\n'
+		<< "input = " << f << '\n'
+		<< "verbose = " << verbose << '\n';
+	for (auto & a: p.args()) std::cout << "argument: " << a << '\n';
+	return 0;
+}
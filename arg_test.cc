@@ -0,0 +1,843 @@
+// Behavior tests for the arg library
+//
+// Each test checks results of the library against expected values. A
+// failing check is reported with its line, and the program exits with a
+// non-zero status for `make check`.
+#include <arg.hh>
+#include <val.hh>
+#include <batch.hh>
+#include <schema.hh>
+#include <spawn.hh>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+using namespace std;
+
+namespace {
+	int failures = 0;
+
+	void check(bool ok, char const * what, int line)
+	{
+		if (ok) return;
+		cerr << "arg_test.cc:" << line << ": check failed: " << what << '\n';
+		failures ++;
+	}
+
+#define CHECK(c) check((c), #c, __LINE__)
+
+	// a temporary file with `text`, removed at destruction
+	struct TempFile {
+		string path;
+		TempFile(string const & text)
+		{
+			char p[] = "/tmp/arg_test.XXXXXX";
+			int fd = mkstemp(p);
+			if (fd < 0) {
+				perror("mkstemp");
+				exit(1);
+			}
+			path = p;
+			if (write(fd, text.data(), text.size()) != ssize_t(text.size())) perror("write");
+			close(fd);
+		}
+		~TempFile()
+		{
+			unlink(path.c_str());
+		}
+	};
+
+	// positional arguments of `p` after parsing `tokens`
+	vector<string> parse_args(arg::Parser & p, vector<string> tokens)
+	{
+		vector<char *> argv;
+		for (auto & t: tokens) argv.push_back(& t[0]);
+		argv.push_back(nullptr);
+		p.parse(argv.size() - 1, argv.data());
+		return p.args();
+	}
+
+	// message of the Error thrown by `f`, empty if none
+	template <typename F>
+	string error_of(F f)
+	{
+		try {
+			f();
+		}
+		catch (arg::Error & e) {
+			return e.get_msg();
+		}
+		return string();
+	}
+
+	void test_response_files()
+	{
+		string const text = "'a' bbbbbbbb 'ccccccc' dd\"e e\"f plain \\ x";
+		vector<string> const want = {"a", "bbbbbbbb", "ccccccc", "dde ef", "plain", " x"};
+		TempFile f(text);
+		arg::Parser p;
+		p.set_response_files();
+		CHECK(parse_args(p, {"test", "@" + f.path}) == want);
+		CHECK(parse_args(p, {"test", "first", "@" + f.path, "last"}).size() == want.size() + 2);
+		string const line = "test " + text;
+		p.parse(string_view(line));
+		CHECK(p.args() == want);
+		auto r = p.scan(string_view(line));
+		CHECK(vector<string>(r.args().begin(), r.args().end()) == want);
+
+		TempFile outer("one @" + f.path + " 'two three'\n");
+		vector<string> nested = {"one"};
+		nested.insert(nested.end(), want.begin(), want.end());
+		nested.push_back("two three");
+		CHECK(parse_args(p, {"test", "@" + outer.path}) == nested);
+		TempFile open_quote("a 'b c");
+		CHECK(error_of([&]{ parse_args(p, {"test", "@" + open_quote.path}); }).size());
+		CHECK(parse_args(p, {"test", "@/nonexistent/file"}) == vector<string>{"@/nonexistent/file"});
+	}
+
+	// a Value counting the calls to `set`, failing on "bad"
+	struct CountingValue :
+		public arg::Value
+	{
+		int & calls;
+		CountingValue(int & c) :
+			calls(c)
+		{}
+		void set(string const & str) override
+		{
+			calls ++;
+			if (str == "bad") throw arg::Error("counted " + str);
+		}
+	};
+
+	void test_try_parse()
+	{
+		int calls = 0;
+		int n = 0;
+		arg::Parser p;
+		p.add_opt('c', "count").store(make_shared<CountingValue>(calls));
+		p.add_opt('n', "number").stow(n);
+		p.add_arg("file").store(make_shared<CountingValue>(calls));
+
+		CHECK(error_of([&]{ p.parse(vector<string_view>{"test", "-c", "bad", "x"}); }) == "counted bad");
+		CHECK(calls == 1);
+		calls = 0;
+		CHECK(error_of([&]{ p.parse(vector<string_view>{"test", "bad"}); }) == "counted bad");
+		CHECK(calls == 1);
+
+		calls = 0;
+		auto e = p.try_parse(vector<string_view>{"test", "--count=bad", "x"});
+		CHECK(e.code == arg::ParseCode::bad_value);
+		CHECK(e.index == 0);
+		CHECK(e.value == "bad");
+		CHECK(calls == 1);
+
+		CHECK(p.try_parse(vector<string_view>{"test", "-n", "x1", "x"}).code == arg::ParseCode::bad_value);
+		CHECK(error_of([&]{ p.parse(vector<string_view>{"test", "-n", "x1", "x"}); }).size());
+		CHECK(p.try_parse(vector<string_view>{"test", "--nope", "x"}).code == arg::ParseCode::unknown_option);
+		CHECK(p.try_parse(vector<string_view>{"test", "x", "-n"}).code == arg::ParseCode::missing_value);
+		CHECK(p.try_parse(vector<string_view>{"test"}).code == arg::ParseCode::argument_count);
+		CHECK(! p.try_parse(vector<string_view>{"test", "-n", "7", "x"}));
+		CHECK(n == 7);
+
+		int m = 0;
+		vector<int> l;
+		arg::Parser q;
+		q.add_opt('n', "number").stow(n);
+		q.add_opt('l', "list").store(make_shared<arg::ListValue<int>>(l));
+		q.add_arg("m").stow(m);
+		e = q.try_parse(vector<string_view>{"test", "-n", "3", "zz"});
+		CHECK(e.code == arg::ParseCode::bad_value);
+		CHECK(e.index == 2);
+		CHECK(e.value == "zz");
+		CHECK(! e.fault); // the Error is made only when reported
+		e = q.try_parse(vector<string_view>{"test", "-l", "1,x2,3", "4"});
+		CHECK(e.code == arg::ParseCode::bad_value && ! e.fault);
+		string bad_list = error_of([&]{ arg::ListValue<int>(l).set("1,x2,3"); });
+		CHECK(bad_list.size() && error_of([&]{ q.parse(vector<string_view>{"test", "-l", "1,x2,3", "4"}); }) == bad_list);
+	}
+
+	void test_copy()
+	{
+		int n = 0;
+		arg::Parser p;
+		p.add_opt('n', "number").stow(n);
+		p.set_stats();
+		{
+			arg::Parser q(p);
+			q.parse(vector<string_view>{"test", "-n", "1"});
+			q = p;
+			CHECK(n == 1);
+		}
+		p.parse(vector<string_view>{"test", "-n", "2"});
+		CHECK(n == 2);
+		CHECK(p.get_stats()->find('n')->hits == 2);
+	}
+
+	void test_value_copy()
+	{
+		int v = 0;
+		string t;
+		auto s = make_unique<arg::SetValue>(v);
+		s->add("one", 1);
+		s->add("two", 2);
+		auto u = make_unique<arg::TermValue>(t);
+		u->add("red");
+		u->add("green");
+		arg::SetValue s2(* s);
+		arg::TermValue u2(* u);
+		s.reset();
+		u.reset();
+		CHECK(s2.try_set("two") && v == 2);
+		CHECK(! s2.try_set("three"));
+		CHECK(u2.try_set("green") && t == "green");
+		CHECK(! u2.try_set("blue"));
+	}
+
+	void test_launcher()
+	{
+		arg::Parser p;
+		arg::Launcher l(p, "sh");
+		l.append("-c").append("exit $#").append("sh");
+		for (int i = 0; i < 40; i ++) l.append(to_string(i)); // moving the tokens on the way
+		CHECK(l.get_args().size() == 44);
+		int status = 0;
+		CHECK(waitpid(l.spawn(), & status, 0) > 0);
+		CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 40);
+	}
+
+	void test_list_value()
+	{
+		vector<string> l;
+		arg::ListValue<string> v(l);
+		for (string s: {"a,b,c", ",b", "a,,c", "", "x"}) {
+			CHECK(v.try_set(s));
+			CHECK(v.to_str() == s);
+		}
+		vector<double> d;
+		arg::ListValue<double> w(d, ':');
+		CHECK(w.try_set("1.5:-2:0.1"));
+		CHECK(d.size() == 3 && d[2] == 0.1);
+		CHECK(w.to_str() == "1.5:-2:0.1");
+		CHECK(! w.try_set("1:x"));
+		CHECK(d.size() == 3 && d[0] == 1.5); // kept on failure
+		vector<int> i = {1, 2, 3};
+		arg::ListValue<int> iv(i);
+		CHECK(! iv.try_set("4,x,6"));
+		CHECK(i == (vector<int>{1, 2, 3}));
+		CHECK(error_of([&]{ iv.set("4,5,y"); }).find("'y'") != string::npos);
+		CHECK(i == (vector<int>{1, 2, 3}));
+		CHECK(iv.try_set("7,8") && i == (vector<int>{7, 8}));
+	}
+
+	void test_option_copy()
+	{
+		int n = 0;
+		arg::Option o('n', "number");
+		o.stow(n).help("a number").show_default();
+		arg::Option c(o);
+		c.help("another number").env("NUM");
+		CHECK(o.get_help_body() == "a number (default: 0)");
+		CHECK(c.get_help_body() == "another number (default: 0)");
+		o = c;
+		c.help("third");
+		CHECK(o.get_help_body() == "another number (default: 0)");
+	}
+
+	void test_config_precedence()
+	{
+		int n = 0;
+		int m = 0;
+		arg::Parser p;
+		p.add_opt('n', "number").stow(n);
+		p.add_opt('m', "more").stow(m);
+		string const config = "number = 7\nmore = 8\n";
+		p.parse(vector<string_view>{"test", "-n", "5"});
+		p.parse_config(string_view(config), "config");
+		CHECK(n == 5 && m == 8);
+		p.parse(vector<string_view>{"test", "-m", "1"});
+		p.parse_config(string_view(config), "config");
+		CHECK(n == 7 && m == 1); // given in an earlier parse only
+	}
+
+	void test_long_without_value()
+	{
+		bool verbose = false;
+		int level = 0;
+		int n = 0;
+		arg::Parser p;
+		p.add_opt('v', "verbose").set(verbose);
+		p.add_opt('l', "level").stow(level).optional("3");
+		p.add_opt('n', "number").stow(n);
+		p.parse(vector<string_view>{"test", "--verbose", "--level"});
+		CHECK(verbose && level == 3);
+		p.parse(vector<string_view>{"test", "--level=5"});
+		CHECK(level == 5);
+		CHECK(p.try_parse(vector<string_view>{"test", "--number"}).code == arg::ParseCode::missing_value);
+		CHECK(p.try_parse(vector<string_view>{"test", "--verbose="}).code == arg::ParseCode::unwanted_value);
+	}
+
+	void test_lazy()
+	{
+		int n = 0;
+		int m = 0;
+		arg::Parser p;
+		p.add_opt('n', "number").stow(n);
+		p.add_opt('m', "more").stow(m);
+		p.set_lazy();
+		p.parse(vector<string_view>{"test", "-n", "5", "-m", "x", "-m", "6"});
+		CHECK(n == 0 && m == 0);
+		p.get_opt("number").process("7"); // replaces the value left
+		p.materialize();
+		CHECK(n == 7 && m == 6);
+		p.parse(vector<string_view>{"test", "-n", "bad"});
+		auto e = p.try_materialize();
+		CHECK(e.code == arg::ParseCode::bad_value && e.value == "bad");
+	}
+
+	void test_help_default()
+	{
+		int n = 1;
+		arg::Parser p;
+		p.add_opt('n', "number").stow(n).help("a number").show_default();
+		CHECK(p.get_help().find("(default: 1)") != string::npos);
+		n = 2;
+		CHECK(p.get_help().find("(default: 2)") != string::npos);
+	}
+
+	void test_env()
+	{
+		int n = 0;
+		int m = 0;
+		bool f = false;
+		arg::Parser p;
+		p.set_env_prefix("T_");
+		p.add_opt('n', "number").stow(n).env();
+		p.add_opt('m').stow(m).env("T_MORE");
+		p.add_opt('f', "flag").set(f).env();
+		CHECK(error_of([&]{ p.add_opt('k').env(); }) == "no variable name for option -k");
+		char const * envp[] = {"T_NUMBER=3", "T_MORE=4", "T_FLAG=no", "OTHER=1", nullptr};
+		p.parse(vector<string_view>{"test", "-n", "1"});
+		p.parse_env(envp);
+		CHECK(n == 1 && m == 4 && ! f); // the command line takes precedence
+		p.parse_config(string_view("number = 5\n"), "config");
+		CHECK(n == 1);
+		p.parse(vector<string_view>{"test"});
+		p.parse_env(envp);
+		CHECK(n == 3);
+		p.parse_config(string_view("number = 5\n"), "config");
+		CHECK(n == 3); // the environment takes precedence over configuration
+		char const * bad[] = {"T_NUMBER=x", nullptr};
+		p.parse(vector<string_view>{"test"});
+		CHECK(error_of([&]{ p.parse_env(bad); }).find("T_NUMBER") != string::npos);
+	}
+
+	// completions of `words` by `p`
+	vector<string> complete(arg::Parser const & p, vector<string_view> const & words)
+	{
+		vector<string> out;
+		p.complete(words, out);
+		return out;
+	}
+
+	void test_completion()
+	{
+		int n = 0;
+		bool v = false;
+		string color;
+		auto term = make_shared<arg::TermValue>(color);
+		term->add("red");
+		term->add("green");
+		arg::Parser p;
+		p.add_opt('n', "number").stow(n);
+		p.add_opt('c', "name").store(term);
+		p.add_opt('v').set(v);
+		CHECK(complete(p, {"--n"}) == (vector<string>{"--number=", "--name="}));
+		CHECK(complete(p, {"--name", "=", "g"}) == vector<string>{"--name=green"});
+		CHECK(complete(p, {"--name=r"}) == vector<string>{"--name=red"});
+		CHECK(complete(p, {"-vc"}) == (vector<string>{"-vcred", "-vcgreen"}));
+		CHECK(complete(p, {"-"}) == (vector<string>{"-n", "-c", "-v", "--number=", "--name="}));
+		CHECK(complete(p, {"--", "--n"}).empty());
+
+		p.parse(vector<string_view>{"/bin/my tool'x"});
+		string bash = p.get_completion_script("bash");
+		CHECK(bash.find("\ncomplete -F _arg_complete_my_tool_x -- 'my tool'\\''x'\n") != string::npos);
+		string zsh = p.get_completion_script("zsh");
+		CHECK(zsh.find("#compdef") == string::npos);
+		CHECK(zsh.find("\ncompdef _arg_complete_my_tool_x 'my tool'\\''x'\n") != string::npos);
+		p.parse(vector<string_view>{"/bin/tool"});
+		CHECK(! p.get_completion_script("zsh").compare(0, 14, "#compdef tool\n"));
+	}
+
+	void test_wide_keys()
+	{
+		arg::Parser p;
+		for (int k = 256; k < 1256; k ++) p.add_opt(k, "option-" + to_string(k));
+		p.add_opt(-5);
+		CHECK(p.find(1000) && p.find(1000)->get_name() == "option-1000");
+		CHECK(p.find(-5) && ! p.find(2000));
+		CHECK(error_of([&]{ p.add_opt(300); }) == "duplicated option key: 300");
+		p.remove(300);
+		CHECK(! p.find(300) && p.find(301));
+		p.add_opt(300);
+		CHECK(p.find(300) != nullptr);
+	}
+
+	// tokens read from `text` by an FdSource with buffers of `size`, each checked to
+	// stay valid through the next call
+	vector<string> read_fd(string const & text, char delim, size_t size)
+	{
+		TempFile f(text);
+		arg::Parser::FdSource src(open(f.path.c_str(), O_RDONLY), delim, size, true);
+		vector<string> toks;
+		string_view prev;
+		string_view tok;
+		while (src.next(tok)) {
+			if (toks.size()) CHECK(prev == toks.back());
+			toks.emplace_back(tok);
+			prev = tok;
+		}
+		if (toks.size()) CHECK(prev == toks.back());
+		return toks;
+	}
+
+	void test_fd_source()
+	{
+		string const a(20, 'a');
+		string const b(9, 'b');
+		vector<string> const lines = {"x", a, "yyyyyyy", "zzzzzzzz", b, "w"};
+		string text;
+		for (auto & l: lines) text += l + "\n\n";
+		text.pop_back();
+		text.pop_back(); // the last token without a delimiter
+		vector<string> const nuls = {"x", a, "", b, ""};
+		string ntext = string("x") + '\0' + a + '\0' + '\0' + b + '\0' + '\0';
+		for (size_t size: {1, 2, 3, 8, 9, 64}) {
+			CHECK(read_fd(text, '\n', size) == lines);
+			CHECK(read_fd(ntext, '\0', size) == nuls);
+		}
+		CHECK(read_fd("", '\n', 4).empty());
+
+		// positional arguments read through --args-from, kept after the parse
+		TempFile f(a + "\n-n\n5\n" + b + "\n");
+		int n = 0;
+		arg::Parser p;
+		p.add_opt('n', "number").stow(n);
+		p.add_opt_args_from();
+		p.parse(vector<string_view>{"test", "first", "--args-from=" + f.path, "last"});
+		CHECK(n == 5);
+		CHECK(p.args() == (vector<string>{"first", a, b, "last"}));
+		vector<string> tokens = {"test", "--args-from=" + f.path, "last"};
+		vector<char *> argv;
+		for (auto & t: tokens) argv.push_back(& t[0]);
+		vector<string> streamed;
+		for (auto t: p.stream(argv.size(), argv.data())) streamed.emplace_back(t);
+		CHECK(streamed == (vector<string>{a, b, "last"}));
+
+		// a copy reads into itself, also after the parser adding the option is gone
+		p.parse(vector<string_view>{"test", "first"});
+		arg::Parser c(p);
+		c.parse(vector<string_view>{"test", "--args-from=" + f.path});
+		CHECK(c.args() == (vector<string>{a, b}));
+		CHECK(p.args() == (vector<string>{"first"}));
+		auto r = make_unique<arg::Parser>();
+		r->add_opt('n', "number").stow(n);
+		r->add_opt_args_from();
+		arg::Parser q(* r);
+		r.reset();
+		q.parse(vector<string_view>{"test", "--args-from=" + f.path});
+		CHECK(q.args() == (vector<string>{a, b}));
+		CHECK(error_of([&]{ p.parse_config(string_view("args-from = " + f.path), "config"); }).size());
+	}
+
+	void test_string_value()
+	{
+		string str;
+		arg::Parser p;
+		p.add_opt('s', "str").stow(str);
+		p.parse(vector<string_view>{"test", "--str= a b"});
+		CHECK(str == " a b");
+		p.parse(vector<string_view>{"test", "-s", ""});
+		CHECK(str.empty());
+	}
+
+	void test_batch()
+	{
+		int n = 0;
+		string name;
+		arg::Parser p;
+		p.add_opt('n', "number").stow(n);
+		p.add_opt('v', "verbose");
+		p.add_opt("name").stow(name);
+		p.add_arg("file");
+
+		arg::Batch b(p);
+		auto & num = b.column<int>("number");
+		auto & verbose = b.column<char>("verbose");
+		auto & file = b.arg<string>(0);
+		b.parse("t -n 3 a\nt -v --name=x b\nt -n zz c\nt --nope d\nt -n 1\nt -vn 2 'e f'\r\nt 'g");
+		CHECK(b.size() == 7);
+		auto & err = b.errors();
+		CHECK(err[0].empty() && num.given[0] && num.values[0] == 3 && ! verbose.given[0] && file.values[0] == "a");
+		CHECK(err[1].empty() && ! num.given[1] && verbose.given[1] && file.values[1] == "b");
+		CHECK(err[2] == error_of([&]{ arg::StreamableValue<int>(n).set("zz"); })); // as the value would say
+		CHECK(! num.given[2] && ! file.given[2]);
+		CHECK(err[3] == "unknown option: nope" && ! file.given[3]);
+		CHECK(err[4] == "number of arguments mismatch");
+		CHECK(err[5].empty() && num.values[5] == 2 && verbose.given[5] && file.values[5] == "e f");
+		CHECK(err[6].size() && ! file.given[6]);
+		CHECK(n == 0 && name.empty()); // the parser is left alone
+
+		string text;
+		int const lines = 5000;
+		for (int i = 0; i < lines; i ++) text += "t -n " + to_string(i) + (i % 7 ? " f\n" : " --bad f\n");
+		for (unsigned threads: {1u, 4u}) {
+			b.parse(text, threads);
+			CHECK(b.size() == lines);
+			bool ok = true;
+			for (int i = 0; i < lines; i ++) {
+				if (i % 7) ok = ok && b.errors()[i].empty() && num.given[i] && num.values[i] == i;
+				else ok = ok && b.errors()[i] == "unknown option: bad" && ! num.given[i];
+			}
+			CHECK(ok);
+		}
+	}
+	bool callback(int, string const &, void *)
+	{
+		return true;
+	}
+
+	void test_get_argv()
+	{
+		int n = 1;
+		int m = 2;
+		bool v = false;
+		string name = "x";
+		int a = 0;
+		int b = 0;
+		arg::Parser p;
+		p.add_opt('n', "number").stow(n);
+		p.add_opt('m').stow(m);
+		p.add_opt('v', "verbose").set(v);
+		p.add_opt("name").stow(name);
+		auto sub = make_shared<arg::SubParser>();
+		sub->add_opt("a").stow(a);
+		sub->add_opt("b").stow(b);
+		sub->set_assign(':');
+		p.add_opt('s', "sub").store(sub);
+		p.add_opt('c', "call").call(& callback, nullptr);
+
+		CHECK(p.get_argv().empty());
+		p.parse(vector<string_view>{"t", "-n", "4", "-m", "5", "-v", "--sub=b:3"});
+		CHECK((p.get_argv() == vector<string>{"--number=4", "-m", "5", "--verbose", "--sub=b:3"}));
+		p.parse(vector<string_view>{"t", "--name=y", "--sub=a:1,b:2"});
+		CHECK((p.get_argv() == vector<string>{"--number=4", "-m", "5", "--verbose", "--name=y", "--sub=a:1,b:2"}));
+
+		arg::Parser q;
+		int k = 0;
+		q.add_opt('k', "k").stow(k);
+		k = 9; // a default set after storing, before anything is given
+		CHECK(q.get_argv().empty());
+		q.parse(vector<string_view>{"t", "-k", "9"});
+		CHECK(q.get_argv().empty());
+
+		p.parse(vector<string_view>{"t", "-c"});
+		CHECK(error_of([&]{ p.get_argv(); }) == "can not give back the callback for option: call");
+	}
+	void test_abbreviations()
+	{
+		bool v = false;
+		bool w = false;
+		bool x = false;
+		arg::Parser p;
+		p.add_opt('v', "verb").set(v);
+		p.add_opt('w', "verbose").set(w);
+		p.add_opt('x', "extra").set(x);
+		p.set_abbreviations();
+
+		// an exact name beats the longer names it starts
+		p.parse(vector<string_view>{"test", "--verb"});
+		CHECK(v && ! w);
+		v = false;
+		p.parse(vector<string_view>{"test", "--verbo", "--ex"});
+		CHECK(! v && w && x);
+
+		// a prefix of several names
+		w = false;
+		p.add_opt("verify");
+		auto e = p.try_parse(vector<string_view>{"test", "--ver"});
+		CHECK(e.code == arg::ParseCode::ambiguous_option);
+		CHECK(e.token == "ver");
+		CHECK(e.message() == "ambiguous option: ver (could be verb, verbose, verify)");
+		bool ambiguous = false;
+		try {
+			p.parse(vector<string_view>{"test", "--ver"});
+		}
+		catch (arg::AmbigError &) {
+			ambiguous = true;
+		}
+		CHECK(ambiguous);
+		CHECK(p.try_parse(vector<string_view>{"test", "--ver"}, true).code == arg::ParseCode::ambiguous_option); // not unknown
+
+		// the names left after removing
+		p.remove("verify");
+		p.remove('v');
+		p.parse(vector<string_view>{"test", "--ver"});
+		CHECK(w);
+		CHECK(p.try_parse(vector<string_view>{"test", "--verif"}).code == arg::ParseCode::unknown_option);
+		p.add_opt("verify");
+		CHECK(p.try_parse(vector<string_view>{"test", "--ver"}).code == arg::ParseCode::ambiguous_option);
+
+		p.set_abbreviations(false);
+		CHECK(p.try_parse(vector<string_view>{"test", "--verbo"}).code == arg::ParseCode::unknown_option);
+	}
+	void test_sub_parser()
+	{
+		int x = 0;
+		int y = 0;
+		string z;
+		bool f = false;
+		arg::Parser p;
+		auto sub = make_shared<arg::SubParser>();
+		sub->add_opt("x").stow(x);
+		sub->add_opt("y").stow(y);
+		sub->add_opt("z").stow(z);
+		sub->add_opt("f").set(f);
+		p.add_opt('s', "sub").store(sub);
+
+		p.parse(vector<string_view>{"test", "--sub=z=a=b"}); // split at the first '='
+		CHECK(z == "a=b");
+		p.parse(vector<string_view>{"test", "-s", "x=1,,y=2,"}); // empty fields skipped
+		CHECK(x == 1 && y == 2);
+		p.parse(vector<string_view>{"test", "--sub=f"});
+		CHECK(f);
+		CHECK(error_of([&]{ p.parse(vector<string_view>{"test", "--sub=w=1"}); }) == "unknown option: w");
+		CHECK(error_of([&]{ p.parse(vector<string_view>{"test", "--sub=x=a"}); }).size());
+
+		sub->set_sep(';');
+		sub->set_assign(':');
+		p.parse(vector<string_view>{"test", "--sub=x:3;;z:c,d=e;y:4"});
+		CHECK(x == 3 && y == 4 && z == "c,d=e");
+		p.parse(vector<string_view>{"test", "--sub=z:a:b"});
+		CHECK(z == "a:b");
+		CHECK(error_of([&]{ p.parse(vector<string_view>{"test", "--sub=x=5"}); }) == "unknown option: x=5");
+	}
+	constexpr arg::Schema schema{{
+		{'n', "number", "INT", "a number"},
+		{'v', "verbose", "", "more messages"},
+		{'q', "", "", "quiet"},
+		{0, "name", "NAME", "a name"},
+	}};
+	static_assert(schema.find('n') == 0 && schema.find('q') == 2, "keys");
+	static_assert(schema.find('x') == -1 && schema.find(0) == -1 && schema.find(300) == -1, "missing keys");
+	static_assert(schema.find("verbose") == 1 && schema.find("name") == 3 && schema.find("number") == 0, "names");
+	static_assert(schema.find("") == -1 && schema.find("nam") == -1 && schema.find("names") == -1, "missing names");
+
+	void test_schema()
+	{
+		int n = 0;
+		bool v = false;
+		bool q = false;
+		string name;
+		auto b = schema.bind(n, v, q, name);
+		// parse `tokens` with `b` as with `Parser`, the error message if any
+		auto parse = [&](vector<string> & tokens){
+			vector<char *> argv;
+			for (auto & t: tokens) argv.push_back(& t[0]);
+			return error_of([&]{ b.parse(argv.size(), argv.data()); });
+		};
+		vector<string> t = {"t", "-vqn5", "a", "--name=x y", "b"};
+		CHECK(parse(t).empty());
+		CHECK(n == 5 && v && q && name == "x y");
+		CHECK(b.args() == (vector<string_view>{"a", "b"}));
+		t = {"t", "-qn", "6"};
+		CHECK(parse(t).empty() && n == 6);
+		t = {"t", "-n"};
+		CHECK(parse(t) == "missing value for option: n");
+		t = {"t", "--name"};
+		CHECK(parse(t) == "missing value for option: name");
+		t = {"t", "--verbose=1"};
+		CHECK(parse(t) == "unwanted value '1' for option: verbose");
+		t = {"t", "-x"};
+		CHECK(parse(t) == "unknown option: -x");
+		t = {"t", "--nam=x"};
+		CHECK(parse(t) == "unknown option: nam");
+		t = {"t", "-n", "x"};
+		CHECK(parse(t).size());
+
+		// `-` and `--` taken as by `Parser`
+		int m = 0;
+		arg::Parser p;
+		p.add_opt('n', "number").stow(m);
+		for (vector<string> u: {vector<string>{"t", "-", "a"}, vector<string>{"t", "--", "a"}, vector<string>{"t", "-n", "-"}}) {
+			t = u;
+			vector<string_view> views(t.begin(), t.end());
+			CHECK(parse(t) == error_of([&]{ p.parse(views); }));
+			CHECK(b.args().size() == p.args().size());
+		}
+	}
+	// `int` values appended to a list, one for each `set`
+	struct AppendValue :
+		public arg::Value
+	{
+		vector<int> & list;
+		AppendValue(vector<int> & list) :
+			list(list)
+		{}
+		void set(string const & str) override
+		{
+			int i;
+			if (! arg::parse_value(str, i)) throw arg::ConvError(str, "int");
+			list.push_back(i);
+		}
+	};
+
+	void test_variadic()
+	{
+		string mode;
+		vector<int> nums;
+		arg::Parser p;
+		p.add_opt('v', "verbose");
+		p.add_arg("mode").stow(mode);
+		p.add_arg("num").store(make_shared<AppendValue>(nums)).variadic();
+
+		CHECK(p.try_parse(vector<string_view>{"t"}).code == arg::ParseCode::argument_count);
+		CHECK(p.try_parse(vector<string_view>{"t", "-v", "add"}).code == arg::ParseCode::argument_count);
+		CHECK(! p.try_parse(vector<string_view>{"t", "add", "1"}));
+		CHECK(mode == "add" && nums == vector<int>{1});
+		nums.clear();
+		CHECK(! p.try_parse(vector<string_view>{"t", "sum", "1", "-v", "2", "3"}));
+		CHECK(mode == "sum" && nums == (vector<int>{1, 2, 3}));
+		nums.clear();
+		auto e = p.try_parse(vector<string_view>{"t", "sum", "1", "-v", "x", "3"});
+		CHECK(e.code == arg::ParseCode::bad_value && e.index == 3 && e.token == "x");
+		CHECK(error_of([&]{ p.parse(vector<string_view>{"t", "sum", "1", "x"}); }) == error_of([&]{ AppendValue(nums).set("x"); }));
+
+		// the same through a Stream, converted as they come
+		nums.clear();
+		vector<string> t = {"t", "-v", "sum", "4", "5", "-v", "6"};
+		vector<char *> argv;
+		for (auto & s: t) argv.push_back(& s[0]);
+		auto s = p.stream(argv.size(), argv.data());
+		vector<size_t> positions;
+		vector<size_t> sizes;
+		while (s.next()) {
+			positions.push_back(s.position());
+			sizes.push_back(nums.size());
+		}
+		CHECK(s.at_end() && mode == "sum" && nums == (vector<int>{4, 5, 6}));
+		CHECK(positions == (vector<size_t>{1, 2, 3, 4}));
+		CHECK(sizes == (vector<size_t>{0, 1, 2, 3}));
+		t = {"t", "sum", "7", "y"};
+		argv.clear();
+		for (auto & s: t) argv.push_back(& s[0]);
+		auto u = p.stream(argv.size(), argv.data());
+		CHECK(! u.try_next() && ! u.try_next());
+		e = u.try_next();
+		CHECK(e.code == arg::ParseCode::bad_value && e.index == 2);
+		t = {"t", "sum"};
+		argv.clear();
+		for (auto & s: t) argv.push_back(& s[0]);
+		auto w = p.stream(argv.size(), argv.data());
+		CHECK(! w.try_next() && w.try_next().code == arg::ParseCode::argument_count);
+
+		// without a variadic argument, one more is too many
+		arg::Parser q;
+		q.add_arg("mode").stow(mode);
+		CHECK(q.try_parse(vector<string_view>{"t", "a", "b"}).code == arg::ParseCode::argument_count);
+		t = {"t", "a", "b"};
+		argv.clear();
+		for (auto & s: t) argv.push_back(& s[0]);
+		auto x = q.stream(argv.size(), argv.data());
+		CHECK(! x.try_next() && x.try_next().code == arg::ParseCode::argument_count);
+	}
+	void test_arena()
+	{
+		int n = 0;
+		vector<int> vals(200);
+		auto p = make_unique<arg::Parser>();
+		p->set_stats();
+		p->add_opt('n', "number").stow(n).help("a number").show_default();
+		for (int i = 0; i < 100; i ++) p->add_opt(1000 + i, "o" + to_string(i)).stow(vals[i]);
+		for (int i = 0; i < 100; i += 2) p->remove(1000 + i);
+		for (int i = 0; i < 100; i += 2) p->add_opt(1000 + i, "r" + to_string(i)).stow(vals[100 + i]); // made again in the arena
+		p->parse(vector<string_view>{"t", "--o1=1", "--r0=2", "--r98=3", "-n", "4"});
+		CHECK(vals[1] == 1 && vals[100] == 2 && vals[198] == 3 && n == 4);
+		CHECK(p->try_parse(vector<string_view>{"t", "--o0=1"}).code == arg::ParseCode::unknown_option);
+		CHECK(p->get_stats()->arena_bytes > 0);
+
+		// copies keep the arena of the parser they came from
+		arg::Option o(* p->find('n'));
+		arg::Parser q(* p);
+		p.reset();
+		o.process("5");
+		CHECK(n == 5 && o.get_help_body() == "a number (default: 5)");
+		q.parse(vector<string_view>{"t", "--o3=6", "-n", "7"});
+		CHECK(vals[3] == 6 && n == 7);
+		q.remove('n');
+		q.add_opt('n', "new").stow(vals[199]);
+		q.parse(vector<string_view>{"t", "-n", "8"});
+		CHECK(vals[199] == 8 && n == 7);
+	}
+
+	void test_concurrent_scan()
+	{
+		int n = 0;
+		arg::Parser p;
+		p.add_opt('n', "number").stow(n);
+		p.add_opt('v', "verbose");
+		p.add_opt("name").stow(n);
+		p.add_arg("file").variadic();
+		arg::Parser const & c = p;
+		int const threads = 4;
+		vector<int> bad(threads);
+		vector<thread> pool;
+		for (int t = 0; t < threads; t ++) pool.emplace_back([&, t]{
+			arg::ParseResult r(c);
+			for (int i = 0; i < 2000; i ++) {
+				string line = "t -vn " + to_string(i) + " --name='a b' f" + to_string(t);
+				c.scan(line, r);
+				if (r.get<int>("number") != i || r.count('v') != 1 || r.args().size() != 1 || r.args()[0] != "f" + to_string(t)) bad[t] ++;
+				if (c.try_scan("t --nope", r).code != arg::ParseCode::unknown_option) bad[t] ++;
+			}
+		});
+		for (auto & t: pool) t.join();
+		CHECK(bad == vector<int>(threads));
+		CHECK(n == 0); // nothing is set
+	}
+}
+
+int main()
+{
+	test_response_files();
+	test_string_value();
+	test_try_parse();
+	test_copy();
+	test_value_copy();
+	test_list_value();
+	test_option_copy();
+	test_config_precedence();
+	test_long_without_value();
+	test_lazy();
+	test_help_default();
+	test_env();
+	test_completion();
+	test_wide_keys();
+	test_fd_source();
+	test_launcher();
+	test_batch();
+	test_get_argv();
+	test_abbreviations();
+	test_sub_parser();
+	test_schema();
+	test_variadic();
+	test_arena();
+	test_concurrent_scan();
+	if (failures) cerr << failures << " check(s) failed\n";
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/* batch.cc
+ *
+ * Copyright (C) 2010,2018 Chun-Chung Chen <cjj@u.washington.edu>
+ *
+ * This file is part of arg.
+ *
+ * arg is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with arg.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "batch.hh"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace arg;
+using namespace std;
+
+ColumnBase::~ColumnBase() {}
+
+Batch::Batch(Parser const & p, bool ignore_unknown) :
+	parser(p),
+	ignore_unknown(ignore_unknown)
+{}
+
+Option const * Batch::option(string const & name) const
+{
+	Option const * o = parser.lookup(string_view(name));
+	if (! o) throw Error("no option for column: " + name);
+	return o;
+}
+
+ColumnBase & Batch::bind(Option const * opt, size_t arg, unique_ptr<ColumnBase> col)
+{
+	bindings.push_back(Binding{opt, arg, move(col)});
+	return * bindings.back().col;
+}
+
+bool Batch::parse_line(string_view line, size_t i, ParseResult & res)
+{
+	if (ParseError err = parser.try_scan(line, res, ignore_unknown)) {
+		error_list[i] = err.message();
+		return false;
+	}
+	// convert `str` into the column of `b`, the Error going to `error_list`
+	auto set = [&](Binding & b, string_view str){
+		if (b.col->try_set(i, str)) return true;
+		error_list[i] = ConvError(string(str), b.col->get_type()).get_msg();
+		return false;
+	};
+	for (auto & o: res.occurrences()) for (auto & b: bindings) {
+		if (b.opt != o.opt) continue;
+		if (o.has_value && ! set(b, o.value)) return false;
+		b.col->given[i] = 1;
+	}
+	for (auto & b: bindings) if (! b.opt && b.arg < res.args().size()) {
+		if (! set(b, res.args()[b.arg])) return false;
+		b.col->given[i] = 1;
+	}
+	return true;
+}
+
+void Batch::parse_lines(vector<string_view> const & lines, size_t begin, size_t end)
+{
+	ParseResult res(parser); // reused for every line
+	for (size_t i = begin; i < end; i ++) {
+		bool ok = false;
+		try {
+			ok = parse_line(lines[i], i, res);
+		}
+		catch (Error & e) {
+			error_list[i] = e.get_msg();
+		}
+		catch (exception & e) {
+			error_list[i] = e.what();
+		}
+		catch (...) { // from a thread, it must not escape
+			error_list[i] = "unknown error";
+		}
+		if (! ok) for (auto & b: bindings) b.col->given[i] = 0;
+	}
+}
+
+void Batch::parse(string_view text, unsigned threads)
+{
+	vector<string_view> lines;
+	for (char const * p = text.data(), * end = p + text.size(); p < end; ) {
+		char const * e = static_cast<char const *>(memchr(p, '\n', end - p));
+		if (! e) e = end;
+		string_view l(p, e - p);
+		if (l.size() && l.back() == '\r') l.remove_suffix(1);
+		lines.push_back(l);
+		p = e + 1;
+	}
+	error_list.assign(lines.size(), string());
+	for (auto & b: bindings) b.col->resize(lines.size());
+	if (! threads) threads = max(thread::hardware_concurrency(), 1u);
+	size_t const min_lines = 1024; // per thread, fewer are not worth starting one for
+	threads = max<size_t>(1, min<size_t>(threads, lines.size() / min_lines));
+	vector<thread> pool;
+	struct Join { // the threads started, even if this one fails
+		vector<thread> & pool;
+		~Join() { for (auto & t: pool) t.join(); }
+	} join{pool};
+	for (unsigned t = 1; t < threads; t ++) { // contiguous chunks, the first for this thread
+		pool.emplace_back(& Batch::parse_lines, this, cref(lines), lines.size() * t / threads, lines.size() * (t + 1) / threads);
+	}
+	parse_lines(lines, 0, lines.size() / threads);
+}
+
+void Batch::parse_file(string const & path, unsigned threads)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) throw Error("can not open file: " + path);
+	struct stat st;
+	if (fstat(fd, & st)) {
+		close(fd);
+		throw Error("can not read file: " + path);
+	}
+	if (! st.st_size) {
+		close(fd);
+		parse(string_view(), threads);
+		return;
+	}
+	void * m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (m == MAP_FAILED) throw Error("can not map file: " + path);
+	madvise(m, st.st_size, MADV_SEQUENTIAL);
+	try {
+		parse(string_view(static_cast<char const *>(m), st.st_size), threads);
+	}
+	catch (...) {
+		munmap(m, st.st_size);
+		throw;
+	}
+	munmap(m, st.st_size);
+}
+
+size_t Batch::size() const
+{
+	return error_list.size();
+}
+
+vector<string> const & Batch::errors() const
+{
+	return error_list;
+}
@@ -0,0 +1,126 @@
+/* batch.hh
+ *
+ * Copyright (C) 2010,2018 Chun-Chung Chen <cjj@u.washington.edu>
+ *
+ * This file is part of arg.
+ *
+ * arg is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with arg.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// This header file provides parsing of many command lines at once:
+//
+//     Column: values of an option or argument over the lines of a Batch
+//      Batch: command lines parsed in parallel against one Parser
+
+#pragma once
+#include "arg.hh"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+namespace arg {
+	/// values of an option or positional argument over the lines of a Batch
+	class ColumnBase
+	{
+	public:
+		virtual ~ColumnBase();
+		std::vector<char> given; ///<whether the option or argument is on each line
+		virtual void resize(std::size_t n) = 0; ///<make room for `n` lines, none given
+		virtual bool try_set(std::size_t line, std::string_view str) = 0; ///<convert the value on a line, `false` if it fails
+		virtual std::string get_type() const = 0; ///<type name of the values
+	};
+
+	/// typed values over the lines of a Batch
+	template <typename T>
+	class Column :
+		public ColumnBase
+	{
+		static_assert(! std::is_same<T, bool>::value, "lines are filled in parallel, use `given` or Column<char> for flags");
+	public:
+		std::vector<T> values; ///<value on each line, meaningful where `given`
+
+		void resize(std::size_t n) override
+		{
+			given.assign(n, 0);
+			values.assign(n, T());
+		}
+
+		bool try_set(std::size_t line, std::string_view str) override
+		{
+			return parse_value(str, values[line]);
+		}
+
+		std::string get_type() const override
+		{
+			return typeid(T).name();
+		}
+	};
+
+	/// many command lines parsed in parallel against one Parser
+	class Batch
+	{
+		Parser const & parser;
+		bool ignore_unknown;
+		struct Binding {
+			Option const * opt; ///<option of the column, `nullptr` for a positional argument
+			std::size_t arg; ///<index of the positional argument
+			std::unique_ptr<ColumnBase> col;
+		};
+		std::vector<Binding> bindings;
+		std::vector<std::string> error_list;
+		Option const * option(std::string const & name) const; ///<option with `name`, throws if not found
+		ColumnBase & bind(Option const * opt, std::size_t arg, std::unique_ptr<ColumnBase> col);
+		bool parse_line(std::string_view line, std::size_t i, ParseResult & res); ///<parse line `i` into the columns, `false` with its error set if it fails
+		void parse_lines(std::vector<std::string_view> const & lines, std::size_t begin, std::size_t end); ///<parse lines `begin` to `end`, catching everything
+	public:
+		/// a batch of lines for `p`, which must not be changed while parsing
+		Batch(
+			Parser const & p, ///<parser with the options
+			bool ignore_unknown = false ///<whether to ignore unknown options
+		);
+
+		/// values of option `name` on each line, the last one if given more than once
+		template <typename T> Column<T> & column(std::string const & name);
+		/// values of positional argument `index` on each line
+		template <typename T> Column<T> & arg(std::size_t index);
+
+		/// parse lines of `text`, errors of each line going to `errors()`
+		void parse(
+			std::string_view text, ///<command lines separated by newlines, each starting with the program name
+			unsigned threads = 0 ///<number of threads, 0 for one per core
+		);
+		/// parse lines of a file
+		void parse_file(
+			std::string const & path, ///<file of command lines
+			unsigned threads = 0 ///<number of threads, 0 for one per core
+		);
+
+		std::size_t size() const; ///<number of lines in the last parse
+		std::vector<std::string> const & errors() const; ///<error message of each line, empty if parsed fine
+	};
+
+	template <typename T>
+	Column<T> & Batch::column(std::string const & name)
+	{
+		return static_cast<Column<T> &>(bind(option(name), 0, std::unique_ptr<ColumnBase>(new Column<T>)));
+	}
+
+	template <typename T>
+	Column<T> & Batch::arg(std::size_t index)
+	{
+		return static_cast<Column<T> &>(bind(nullptr, index, std::unique_ptr<ColumnBase>(new Column<T>)));
+	}
+}
@@ -0,0 +1,256 @@
+/* schema.hh
+ *
+ * Copyright (C) 2010,2018 Chun-Chung Chen <cjj@u.washington.edu>
+ *
+ * This file is part of arg.
+ *
+ * arg is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with arg.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// This header file provides option sets fixed at compile time:
+//
+//     Spec: description of an option
+//   Schema: constexpr table of Specs with lookup and help layout
+//    Bound: a Schema bound to variables, ready to parse
+
+#pragma once
+#include "arg.hh"
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+namespace arg {
+	/// description of an option known at compile time
+	struct Spec {
+		int key; ///<single character key, 0 if none
+		std::string_view name; ///<long name, empty if none
+		std::string_view var; ///<help word for the value, empty for a flag
+		std::string_view help; ///<help text
+	};
+
+	template <std::size_t N> class Bound;
+
+	/// a constant set of options with lookup tables and help layout computed at compile time
+	template <std::size_t N>
+	class Schema
+	{
+		static_assert(N > 0 && N < 32768, "a Schema needs 1 to 32767 options");
+		std::array<Spec, N> specs = {};
+		std::array<short, 256> keys = {}; ///<position in `specs` by key, -1 if none
+		std::array<short, N> names = {}; ///<positions in `specs` sorted by name
+		std::size_t named = 0; ///<number of entries in `names`
+		std::array<unsigned short, N> pads = {}; ///<padding after the option column in help
+
+		static constexpr int compare(std::string_view a, std::string_view b)
+		{
+			for (std::size_t i = 0; i < a.size() && i < b.size(); i ++) {
+				if (a[i] != b[i]) return (unsigned char)a[i] < (unsigned char)b[i] ? -1 : 1;
+			}
+			return a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+		}
+
+		static constexpr bool printable(int key)
+		{
+			return key > ' ' && key < 127;
+		}
+
+		/// width of the option column as laid out by `Option::get_help`
+		static constexpr std::size_t column(Spec const & s)
+		{
+			std::size_t w = 4;
+			if (s.name.size()) w += 4 + s.name.size();
+			if (s.var.size()) w += 1 + s.var.size();
+			return w;
+		}
+	public:
+		/// build the tables, duplicated keys or names fail compilation
+		constexpr Schema(Spec const (& s)[N])
+		{
+			for (auto & k: keys) k = -1;
+			for (std::size_t i = 0; i < N; i ++) {
+				specs[i] = s[i];
+				int k = s[i].key;
+				if (k < 0 || k > 255) throw Error("option key out of range");
+				if (k) {
+					if (keys[k] >= 0) throw Error("duplicated option key");
+					keys[k] = short(i);
+				}
+				if (s[i].name.size()) { // insertion into sorted names
+					std::size_t j = named ++;
+					for (; j > 0; j --) {
+						int c = compare(specs[names[j - 1]].name, s[i].name);
+						if (c == 0) throw Error("duplicated option name");
+						if (c < 0) break;
+						names[j] = names[j - 1];
+					}
+					names[j] = short(i);
+				}
+				if (! k && ! s[i].name.size()) throw Error("option without key or name");
+				std::size_t w = column(s[i]);
+				pads[i] = w < 26 ? 26 - w + 3 : 3;
+			}
+		}
+
+		constexpr std::size_t size() const
+		{
+			return N;
+		}
+
+		constexpr Spec const & operator[](std::size_t i) const
+		{
+			return specs[i];
+		}
+
+		/// position of option with `key`, -1 if not found
+		constexpr int find(int key) const
+		{
+			return key > 0 && key < 256 ? keys[key] : -1;
+		}
+
+		/// position of option with `name`, -1 if not found
+		constexpr int find(std::string_view name) const
+		{
+			std::size_t lo = 0;
+			std::size_t hi = named;
+			while (lo < hi) {
+				std::size_t m = (lo + hi) / 2;
+				int c = compare(specs[names[m]].name, name);
+				if (c == 0) return names[m];
+				if (c < 0) lo = m + 1;
+				else hi = m;
+			}
+			return -1;
+		}
+
+		/// write the help list in the layout of `Parser::get_help`
+		void write_help(std::ostream & os) const
+		{
+			for (std::size_t i = 0; i < N; i ++) {
+				auto & s = specs[i];
+				if (printable(s.key)) os << "  -" << char(s.key);
+				else os << "    ";
+				if (s.name.size()) os << (printable(s.key) ? ", --" : "  --") << s.name;
+				if (s.var.size()) os << (s.name.size() ? '=' : ' ') << s.var;
+				for (unsigned j = 0; j < pads[i]; j ++) os << ' ';
+				os << s.help << '\n';
+			}
+		}
+
+		/// bind variables, one per option in order, for parsing
+		template <typename... T>
+		Bound<N> bind(T &... vars) const
+		{
+			static_assert(sizeof...(T) == N, "need one variable for each option");
+			return Bound<N>(* this, vars...);
+		}
+	};
+
+	/// a Schema with storage for the values of its options
+	template <std::size_t N>
+	class Bound
+	{
+		/// type-erased destination for an option value
+		struct Slot {
+			void * ptr;
+			void (* set)(void *, std::string_view);
+			bool flag; ///<no value is taken, `* ptr` is set to `true`
+		};
+		Schema<N> const & schema;
+		std::array<Slot, N> slots;
+		std::vector<std::string_view> arg_views;
+
+		template <typename T>
+		static void assign(void * p, std::string_view str)
+		{
+			T tmp;
+			if (! parse_value(str, tmp)) throw ConvError(std::string(str), typeid(T).name());
+			* static_cast<T *>(p) = tmp;
+		}
+
+		template <typename T>
+		Slot slot(std::size_t i, T & var)
+		{
+			bool flag = std::is_same<T, bool>::value && ! schema[i].var.size();
+			return Slot{& var, & assign<T>, flag};
+		}
+
+		template <typename... T, std::size_t... I>
+		Bound(Schema<N> const & s, std::index_sequence<I...>, T &... vars) :
+			schema(s),
+			slots{{slot(I, vars)...}}
+		{}
+
+		void process(std::size_t i, std::string_view name, char const * v)
+		{
+			auto & s = slots[i];
+			if (s.flag) {
+				if (v) throw OptError(std::string(name), "unwanted value '" + std::string(v) + "'");
+				* static_cast<bool *>(s.ptr) = true;
+			}
+			else {
+				if (! v) throw OptError(std::string(name), "missing value");
+				s.set(s.ptr, v);
+			}
+		}
+
+		friend class Schema<N>;
+		template <typename... T>
+		Bound(Schema<N> const & s, T &... vars) :
+			Bound(s, std::index_sequence_for<T...>(), vars...)
+		{}
+	public:
+		/// perform command-line parsing with the same syntax as `Parser::parse`
+		void parse(int argc, char * argv[])
+		{
+			arg_views.clear();
+			for (int i = 1; i < argc; i ++) {
+				std::string_view s = argv[i];
+				if (s.empty() || s[0] != '-') { // non-option => argument
+					arg_views.push_back(s);
+					continue;
+				}
+				if (s.size() > 1 && s[1] == '-') { // long options
+					auto k = s.find('=');
+					auto n = s.substr(2, k == s.npos ? s.npos : k - 2);
+					int j = schema.find(n);
+					if (j < 0) throw UnknError(std::string(n));
+					process(j, n, k == s.npos ? nullptr : argv[i] + k + 1);
+					continue;
+				}
+				for (std::size_t k = 1; k < s.size(); k ++) { // short options
+					int j = schema.find((unsigned char)s[k]);
+					if (j < 0) throw UnknError(std::string("-") + s[k]);
+					std::string_view n = s.substr(k, 1);
+					if (slots[j].flag) {
+						process(j, n, nullptr);
+						continue;
+					}
+					if (k + 1 < s.size()) process(j, n, argv[i] + k + 1);
+					else process(j, n, ++ i < argc ? argv[i] : nullptr);
+					break;
+				}
+			}
+		}
+
+		/// positional arguments from the last parse
+		std::vector<std::string_view> const & args() const
+		{
+			return arg_views;
+		}
+	};
+}
@@ -0,0 +1,181 @@
+/* spawn.cc
+ *
+ * Copyright (C) 2010,2018 Chun-Chung Chen <cjj@u.washington.edu>
+ *
+ * This file is part of arg.
+ *
+ * arg is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with arg.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "spawn.hh"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char ** environ;
+
+using namespace arg;
+using namespace std;
+
+namespace {
+	// bytes of the ARG_MAX limit taken by a vector of strings
+	size_t vector_size(char const * const * v)
+	{
+		size_t n = 0;
+		for (; * v; v ++) n += strlen(* v) + 1 + sizeof(char *);
+		return n;
+	}
+
+	// `tok` quoted for a response file
+	string quote(string const & tok)
+	{
+		string q = "'";
+		for (char c: tok) {
+			if (c == '\'') q += "'\\''";
+			else q += c;
+		}
+		return q + "'";
+	}
+
+	// bytes of the longest token, MAX_ARG_STRLEN of Linux
+	size_t max_token()
+	{
+		static size_t const n = 32 * sysconf(_SC_PAGESIZE);
+		return n;
+	}
+}
+
+Launcher::SpillFile::~SpillFile()
+{
+	if (path.size()) unlink(path.c_str());
+}
+
+Launcher::Launcher(Parser const & p, string const & path) :
+	parser(p),
+	path(path)
+{
+	refresh();
+}
+
+Launcher::~Launcher()
+{
+	sweep();
+	for (auto & r: readers) r.second->path.clear(); // still read by a running child
+}
+
+void Launcher::add_tok(string const & t)
+{
+	argv_size += t.size() + 1 + sizeof(char *);
+	if (t.size() >= max_token()) too_long = true;
+}
+
+Launcher & Launcher::append(string const & arg)
+{
+	tail.push_back(arg);
+	bool moved = toks.size() == toks.capacity(); // the strings move, short ones with their characters
+	toks.push_back(arg);
+	if (moved) {
+		argv.clear();
+		for (auto & t: toks) argv.push_back(& t[0]);
+		argv.push_back(nullptr);
+	}
+	else {
+		argv.back() = & toks.back()[0];
+		argv.push_back(nullptr);
+	}
+	add_tok(toks.back());
+	spill_file.reset(); // stale
+	return * this;
+}
+
+void Launcher::refresh()
+{
+	toks.assign(1, path);
+	auto opts = parser.get_argv();
+	toks.insert(toks.end(), opts.begin(), opts.end());
+	toks.insert(toks.end(), tail.begin(), tail.end());
+	argv.clear();
+	argv_size = sizeof(char *);
+	too_long = false;
+	for (auto & t: toks) {
+		argv.push_back(& t[0]);
+		add_tok(t);
+	}
+	argv.push_back(nullptr);
+	spill_file.reset(); // stale, removed once its readers exit
+	sweep();
+}
+
+void Launcher::sweep()
+{
+	readers.erase(remove_if(readers.begin(), readers.end(), [](pair<pid_t, shared_ptr<SpillFile>> const & r){
+		siginfo_t info;
+		info.si_pid = 0;
+		if (waitid(P_PID, r.first, & info, WEXITED | WNOHANG | WNOWAIT) < 0) return errno == ECHILD; // waited on already
+		return info.si_pid != 0; // exited, left for the caller to wait on
+	}), readers.end());
+}
+
+vector<string> const & Launcher::get_args() const
+{
+	return toks;
+}
+
+void Launcher::spill()
+{
+	char const * dir = getenv("TMPDIR");
+	string tmpl = string(dir && * dir ? dir : "/tmp") + "/argXXXXXX";
+	int fd = mkstemp(& tmpl[0]);
+	if (fd < 0) throw Error("can not create response file in " + tmpl.substr(0, tmpl.size() - 10));
+	string text;
+	for (size_t i = 1; i < toks.size(); i ++) text += quote(toks[i]) + '\n';
+	for (size_t k = 0; k < text.size(); ) {
+		ssize_t w = write(fd, text.data() + k, text.size() - k);
+		if (w < 0 && errno == EINTR) continue;
+		if (w <= 0) {
+			close(fd);
+			unlink(tmpl.c_str());
+			throw Error("can not write response file: " + tmpl);
+		}
+		k += w;
+	}
+	close(fd);
+	spill_file = make_shared<SpillFile>();
+	spill_file->path = tmpl;
+	spill_tok = "@" + tmpl;
+	spill_argv = {& toks[0][0], & spill_tok[0], nullptr};
+}
+
+pid_t Launcher::spawn(char * const envp[])
+{
+	if (! envp) envp = environ;
+	char * const * args = argv.data();
+	if (too_long || argv_size + vector_size(envp) > size_t(sysconf(_SC_ARG_MAX))) {
+		if (! spill_file) spill();
+		args = spill_argv.data();
+	}
+	pid_t pid;
+	int err = posix_spawnp(& pid, path.c_str(), nullptr, nullptr, args, envp);
+	if (err) throw Error("can not spawn " + path + ": " + strerror(err));
+	if (args == spill_argv.data()) {
+		sweep();
+		readers.emplace_back(pid, spill_file);
+	}
+	return pid;
+}
@@ -0,0 +1,77 @@
+/* spawn.hh
+ *
+ * Copyright (C) 2010,2018 Chun-Chung Chen <cjj@u.washington.edu>
+ *
+ * This file is part of arg.
+ *
+ * arg is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with arg.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// This header file provides launching of child processes:
+//
+//   Launcher: runs programs with the option values of a Parser
+
+#pragma once
+#include "arg.hh"
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+namespace arg {
+	/// runs a program with the current option values of a Parser
+	class Launcher
+	{
+		Parser const & parser;
+		std::string path;
+		std::vector<std::string> tail; ///<positional arguments after the options
+		std::vector<std::string> toks; ///<program name, options and arguments
+		std::vector<char *> argv; ///<pointers into `toks`
+		std::size_t argv_size; ///<bytes `argv` takes of the ARG_MAX limit
+		bool too_long; ///<a token exceeds the limit of a single one
+		/// response file, removed at destruction unless `path` is cleared
+		struct SpillFile {
+			std::string path;
+			~SpillFile();
+		};
+		std::shared_ptr<SpillFile> spill_file; ///<response file holding `toks` after the name, null until needed
+		std::vector<std::pair<pid_t, std::shared_ptr<SpillFile>>> readers; ///<children given a response file, which is kept until they exit
+		std::vector<char *> spill_argv; ///<program name and "@file"
+		std::string spill_tok;
+		void spill(); ///<write the response file
+		void add_tok(std::string const & t); ///<count `t`, the last of `toks`, in the ARG_MAX limits
+		void sweep(); ///<drop the readers that exited or were waited on
+	public:
+		/// launcher of `path`, which is searched in PATH if it has no '/'
+		Launcher(
+			Parser const & p, ///<parser with the options, changed values of which are given
+			std::string const & path ///<program to run
+		);
+		Launcher(Launcher const &) = delete; ///<`argv` points into the tokens
+		Launcher & operator=(Launcher const &) = delete;
+		~Launcher();
+
+		Launcher & append(std::string const & arg); ///<add a positional argument after the options
+		void refresh(); ///<take the option values again, they are kept from the last refresh otherwise
+		std::vector<std::string> const & get_args() const; ///<program name, options and arguments to be given
+
+		/// start the program, giving the tokens in a response file if they exceed ARG_MAX.
+		/// The file is removed on refresh or destruction once the programs given it have exited,
+		/// and left in place for those still running at destruction.
+		pid_t spawn(
+			char * const envp[] = nullptr ///<environment, the current one if `nullptr`
+		);
+	};
+}
@@ -34,8 +34,21 @@ SetValue::Element::Element(std::string const & name, int value, std::string cons
 
 SetValue::SetValue(int & v) :
 	var(v),
-	help_default(false)
+	help_default(false),
+	auto_value(- 100)
+{
+}
+
+SetValue::SetValue(SetValue const & s) :
+	Value(s),
+	var(s.var),
+	help_title(s.help_title),
+	help_default(s.help_default),
+	set_list(s.set_list),
+	value_index(s.value_index),
+	auto_value(s.auto_value)
 {
+	for (size_t i = 0; i < set_list.size(); i ++) name_index.emplace(set_list[i].name, i);
 }
 
 void SetValue::add_help(string const & title)
@@ -52,23 +65,43 @@ void SetValue::add_help(string const & title, int value)
 	add("help", value, "show this list");
 }
 
-void SetValue::add(string const & name, string const & help)
+void SetValue::insert(string const & name, int value, string const & help)
 {
-	int value = - 100;
-	for (auto & i: set_list) {
-		if (name == i.name) throw Error("duplicated element in SetValue");
-		if (value >= i.value) value = i.value - 1;
-	}
+	if (name_index.count(name)) throw Error("duplicated element in SetValue");
+	if (value_index.count(value)) throw Error("duplicated value in SetValue");
 	set_list.emplace_back(name, value, help);
+	int pos = set_list.size() - 1;
+	name_index.emplace(set_list.back().name, pos);
+	value_index.emplace(value, pos);
+	if (auto_value >= value) auto_value = value - 1;
+}
+
+void SetValue::add(string const & name, string const & help)
+{
+	insert(name, auto_value, help);
 }
 
 void SetValue::add(string const & name, int value, string const & help)
 {
-	for (auto & i: set_list) {
-		if (name == i.name) throw Error("duplicated element in SetValue");
-		if (value == i.value) throw Error("duplicated value in SetValue");
+	insert(name, value, help);
+}
+
+SetValue::Element const & SetValue::find(string const & name) const
+{
+	auto i = name_index.find(name);
+	if (i == name_index.end()) throw Error("element '" + name + "' not found in SetValue");
+	return set_list[i->second];
+}
+
+SetValue::Element const & SetValue::find(int value) const
+{
+	auto i = value_index.find(value);
+	if (i == value_index.end()) {
+		ostringstream os;
+		os << "value '" << value << "' not found in SetValue";
+		throw Error(os.str());
 	}
-	set_list.emplace_back(name, value, help);
+	return set_list[i->second];
 }
 
 void SetValue::set(string const & str)
@@ -81,21 +114,23 @@ void SetValue::set(string const & str)
 		cout << '\n';
 		exit(0);
 	}
-	for (auto & i: set_list) {
-		if (str == i.name) {
-			var = i.value;
-			return;
-		}
-	}
-	throw ConvError(str, "an element in SetValue");
+	if (! try_set(str)) throw ConvError(str, "an element in SetValue");
+}
+
+bool SetValue::try_set(string_view str, exception_ptr *)
+{
+	if (help_default && str == "help") set(string(str)); // print help and quit
+	auto i = name_index.find(str);
+	if (i == name_index.end()) return false;
+	var = set_list[i->second].value;
+	return true;
 }
 
 string SetValue::to_str() const
 {
-	for (auto & i: set_list) {
-		if (var == i.value) return i.name;
-	}
-	throw Error("no such value in Set");
+	auto i = value_index.find(var);
+	if (i == value_index.end()) throw Error("no such value in Set");
+	return set_list[i->second].name;
 }
 
 string SetValue::get_type() const
@@ -103,40 +138,34 @@ string SetValue::get_type() const
 	return "set()";
 }
 
+ConvError SetValue::conv_error(string_view str) const
+{
+	return ConvError(string(str), "an element in SetValue");
+}
+
+void SetValue::complete(string_view prefix, vector<string> & out) const
+{
+	for (auto & e: set_list) if (! e.name.compare(0, prefix.size(), prefix)) out.push_back(e.name);
+}
+
 int SetValue::get_value(string const & name) const
 {
-	for (auto & i: set_list) {
-		if (name == i.name) return i.value;
-	}
-	throw Error("element '" + name + "' not found in SetValue");
+	return find(name).value;
 }
 
 string const & SetValue::get_name(int value) const
 {
-	for (auto & i: set_list) {
-		if (value == i.value) return i.name;
-	}
-	ostringstream os;
-	os << "value '" << value << "' not found in SetValue";
-	throw Error(os.str());
+	return find(value).name;
 }
 
 string const & SetValue::get_help(string const & name) const
 {
-	for (auto & i: set_list) {
-		if (name == i.name) return i.help;
-	}
-	throw Error("element '" + name + "' not found in SetValue");
+	return find(name).help;
 }
 
 string const & SetValue::get_help(int value) const
 {
-	for (auto & i: set_list) {
-		if (value == i.value) return i.help;
-	}
-	ostringstream os;
-	os << "value '" << value << "' not found in SetValue";
-	throw Error(os.str());
+	return find(value).help;
 }
 
 string SetValue::get_help() const
@@ -160,6 +189,16 @@ TermValue::TermValue(std::string & v) :
 {
 }
 
+TermValue::TermValue(TermValue const & t) :
+	Value(t),
+	var(t.var),
+	help_title(t.help_title),
+	help_default(t.help_default),
+	term_list(t.term_list)
+{
+	for (size_t i = 0; i < term_list.size(); i ++) name_index.emplace(term_list[i].name, i);
+}
+
 void TermValue::add_help(string const & title)
 {
 	help_title = title;
@@ -169,11 +208,9 @@ void TermValue::add_help(string const & title)
 
 void TermValue::add(string const & name, string const & help)
 {
-	for (auto e: term_list) if (name == e.name) throw Error("duplicated element in SetValue");
-	Element e;
-	e.name = name;
-	e.help = help;
-	term_list.push_back(e);
+	if (name_index.count(name)) throw Error("duplicated element in SetValue");
+	term_list.push_back(Element{name, help});
+	name_index.emplace(term_list.back().name, term_list.size() - 1);
 }
 
 void TermValue::set(string const & str)
@@ -186,17 +223,21 @@ void TermValue::set(string const & str)
 		cout << '\n';
 		exit(0);
 	}
-	for (auto e: term_list) if (str == e.name) {
-		var = str;
-		return;
-	}
-	throw ConvError(str, "an element in SetValue");
+	if (! try_set(str)) throw ConvError(str, "an element in SetValue");
+}
+
+bool TermValue::try_set(string_view str, exception_ptr *)
+{
+	if (help_default && str == "help") set(string(str)); // print help and quit
+	if (! name_index.count(str)) return false;
+	var = str;
+	return true;
 }
 
 string TermValue::to_str() const
 {
-	for (auto e: term_list) if (var == e.name) return var;
-	throw Error("no such value in Set");
+	if (! name_index.count(var)) throw Error("no such value in Set");
+	return var;
 }
 
 string TermValue::get_type() const
@@ -204,16 +245,27 @@ string TermValue::get_type() const
 	return "term()";
 }
 
+ConvError TermValue::conv_error(string_view str) const
+{
+	return ConvError(string(str), "an element in SetValue");
+}
+
+void TermValue::complete(string_view prefix, vector<string> & out) const
+{
+	for (auto & e: term_list) if (! e.name.compare(0, prefix.size(), prefix)) out.push_back(e.name);
+}
+
 string const & TermValue::get_help(string const & name) const
 {
-	for (auto & e: term_list) if (name == e.name) return e.help;
-	throw Error("element '" + name + "' not found in SetValue");
+	auto i = name_index.find(name);
+	if (i == name_index.end()) throw Error("element '" + name + "' not found in SetValue");
+	return term_list[i->second].help;
 }
 
 string TermValue::get_help() const
 {
 	string help;
-	for (auto e: term_list) {
+	for (auto & e: term_list) {
 		string s = "    ";
 		s += e.name;
 		s += ": ";
@@ -233,24 +285,22 @@ RelValue::RelValue(double & var, bool & is_relative) :
 
 void RelValue::set(string const & str)
 {
-	istringstream i;
-	if (str[0] == '+') { // relative value
-		rel = true;
-		i.str(str.substr(1));
-	}
-	else {
-		rel = false;
-		i.str(str);
-	}
-	i >> v;
+	if (! try_set(str)) throw ConvError(str, get_type());
+}
+
+bool RelValue::try_set(string_view str, exception_ptr *)
+{
+	bool r = str.size() && str[0] == '+'; // relative value
+	double t;
+	if (! parse_value(str.substr(r ? 1 : 0), t)) return false;
+	rel = r;
+	v = t;
+	return true;
 }
 
 string RelValue::to_str() const
 {
-	ostringstream o;
-	if (rel) o << '+';
-	o << v;
-	return o.str();
+	return rel ? '+' + format_value(v) : format_value(v);
 }
 
 string RelValue::get_type() const
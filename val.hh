@@ -28,8 +28,13 @@
 
 #pragma once
 #include "arg.hh"
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <vector>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
 namespace arg {
 	// Extensions:
 
@@ -46,9 +51,16 @@ namespace arg {
 			std::string help;
 			Element(std::string const & name, int value, std::string const & help);
 		};
-		std::vector<Element> set_list;
+		std::deque<Element> set_list; ///<elements in order added, never moved
+		std::unordered_map<std::string_view, int> name_index; ///<position in `set_list` by name
+		std::unordered_map<int, int> value_index; ///<position in `set_list` by value
+		int auto_value; ///<value for the next element added without one
+		void insert(std::string const & name, int value, std::string const & help); ///<add an element, rejecting duplicates
+		Element const & find(std::string const & name) const; ///<element by name, throws if not found
+		Element const & find(int value) const; ///<element by value, throws if not found
 	public:
 		SetValue(int & var); ///<make a SetValue from `int &`
+		SetValue(SetValue const & s); ///<copy with `name_index` viewing the names of the copy
 		/// add a special `help` element to the set
 		void add_help(std::string const & title = "Available values:");
 		/// add a `help` element mapped with an `int` value to the set
@@ -59,8 +71,11 @@ namespace arg {
 		void add(std::string const & name, int value, std::string const & help = "");
 
 		void set(std::string const & str) override;
+		bool try_set(std::string_view str, std::exception_ptr * fault = nullptr) override;
 		std::string to_str() const override;
 		std::string get_type() const override;
+		ConvError conv_error(std::string_view str) const override;
+		void complete(std::string_view prefix, std::vector<std::string> & out) const override;
 
 		// additional access to set
 		int get_value(std::string const & name) const;
@@ -81,9 +96,11 @@ namespace arg {
 			std::string name;
 			std::string help;
 		};
-		std::vector<Element> term_list;
+		std::deque<Element> term_list; ///<terms in order added, never moved
+		std::unordered_map<std::string_view, int> name_index; ///<position in `term_list` by name
 	public:
 		TermValue(std::string & var); ///<make `string` a TermValue
+		TermValue(TermValue const & t); ///<copy with `name_index` viewing the terms of the copy
 		void add_help(std::string const & title = "Available values:"); ///<add a `help` term
 		void add(
 			std::string const & name, ///<the term
@@ -91,8 +108,11 @@ namespace arg {
 		); ///<add a term
 
 		void set(std::string const & str) override;
+		bool try_set(std::string_view str, std::exception_ptr * fault = nullptr) override;
 		std::string to_str() const override;
 		std::string get_type() const override;
+		ConvError conv_error(std::string_view str) const override;
+		void complete(std::string_view prefix, std::vector<std::string> & out) const override;
 
 		// additional access to set
 		std::string const & get_help(std::string const & name) const;
@@ -106,6 +126,35 @@ namespace arg {
 	{
 		std::vector<T> & plist;
 		char sep;
+		std::vector<T> spare; ///<converted into and swapped with `plist` on success, keeping the list on failure
+
+		/// convert fields of `str` into `out`, `false` with `bad` set to the first failing one
+		bool convert(std::string_view str, std::vector<T> & out, std::string_view & bad) const
+		{
+			out.clear();
+			char const * p = str.data();
+			char const * e = p + str.size();
+			out.reserve(std::count(p, e, sep) + 1);
+			while (p < e) { // convert each field in place at the end of the list
+				char const * q = static_cast<char const *>(std::memchr(p, sep, e - p));
+				if (! q) q = e;
+				out.emplace_back();
+				if (! parse_value(std::string_view(p, q - p), out.back())) {
+					bad = std::string_view(p, q - p);
+					return false;
+				}
+				p = q + 1;
+			}
+			return true;
+		}
+
+		/// convert `str` into the list, leaving it as it is on failure
+		bool convert(std::string_view str, std::string_view & bad)
+		{
+			if (! convert(str, spare, bad)) return false;
+			plist.swap(spare);
+			return true;
+		}
 	public:
 		/// make a list of value from `vector`
 		ListValue(
@@ -118,28 +167,34 @@ namespace arg {
 
 		void set(std::string const & str) override
 		{
-			plist.clear();
-			std::string::size_type n = 0;
-			while (n < str.length()) {
-				std::string::size_type m = str.find(sep, n);
-				if (m == std::string::npos) m = str.length();
-				std::istringstream i(str.substr(n, m - n));
-				T v;
-				i >> v;
-				plist.push_back(v);
-				n = m + 1;
-			}
+			std::string_view bad;
+			if (! convert(str, bad)) throw ConvError(std::string(bad), typeid(T).name());
+		}
+
+		bool try_set(std::string_view str, std::exception_ptr * = nullptr) override
+		{
+			std::string_view bad;
+			return convert(str, bad);
+		}
+
+		ConvError conv_error(std::string_view str) const override
+		{
+			std::vector<T> out;
+			std::string_view bad;
+			convert(str, out, bad);
+			return ConvError(std::string(bad), typeid(T).name());
 		}
 
 		std::string to_str() const override
 		{
-			std::ostringstream o;
-			std::string s;
+			std::string o;
+			bool first = true;
 			for (auto & i: plist) {
-				o << s << i;
-				s = sep;
+				if (! first) o += sep;
+				first = false;
+				o += format_value(i);
 			}
-			return o.str();
+			return o;
 		}
 
 		std::string get_type() const override
@@ -160,6 +215,7 @@ namespace arg {
 			bool & is_relative ///<is it relative?
 		); ///<a `double` value that can be relative
 		void set(std::string const & str);
+		bool try_set(std::string_view str, std::exception_ptr * fault = nullptr);
 		std::string to_str() const;
 		std::string get_type() const;
 	};